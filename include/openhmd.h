@@ -44,6 +44,7 @@ typedef enum {
 	OHMD_S_UNKNOWN_ERROR = -1,
 	OHMD_S_INVALID_PARAMETER = -2,
 	OHMD_S_UNSUPPORTED = -3,
+	OHMD_S_TIMEOUT = -4,
 
 	/** OHMD_S_USER_RESERVED and below can be used for user purposes, such as errors within ohmd wrappers, etc. */
 	OHMD_S_USER_RESERVED = -16384,
@@ -125,6 +126,33 @@ typedef enum {
 	/** int[1] (get): Physical vertical resolution of the device screen. */
 	OHMD_SCREEN_VERTICAL_RESOLUTION       =  1,
 
+	/** int[1] (get): Bit mask of the ohmd_float_value values ohmd_device_getf can read for the device, value v is
+	    supported if (mask & (1 << v)) is non-zero. Fixed for as long as the device is open. */
+	OHMD_SUPPORTED_FLOAT_VALUES           =  2,
+	/** int[1] (get): Bit mask of the ohmd_int_value values ohmd_device_geti can read for the device, like
+	    OHMD_SUPPORTED_FLOAT_VALUES. */
+	OHMD_SUPPORTED_INT_VALUES             =  3,
+
+	/** int[1] (get): Number of the newest sensor sample the pose was built from, as returned by
+	    ohmd_device_wait_for_sample. Compare to a previous value to tell if there was new sensor data. */
+	OHMD_SAMPLE_NUMBER                    =  4,
+	/** int[1] (get): Generation of the pose, increases whenever any of the pose values of ohmd_device_getf
+	    change, whether from new sensor data or from a correction or property being set. */
+	OHMD_POSE_GENERATION                  =  5,
+
+	/** int[1] (get): Number of sensor reports read from the device but not fused yet, for devices that are
+	    read on a thread of their own. */
+	OHMD_SENSOR_QUEUE_DEPTH               =  6,
+	/** int[1] (get): Number of sensor reports dropped because they were read faster than they were fused. */
+	OHMD_SENSOR_QUEUE_OVERRUNS            =  7,
+
+	/** int[1] (get): Number of sensor samples taken by the device that never arrived, detected from gaps in the
+	    device timestamps. Fusion carries the last known motion over them. */
+	OHMD_DROPPED_SAMPLES                  =  8,
+	/** int[1] (get): Number of sensor samples that arrived late, merged with later samples because the
+	    device wasn't read often enough. They are fused as one longer step. */
+	OHMD_LATE_SAMPLES                     =  9,
+
 } ohmd_int_value;
 
 /** A collection of data information types used for setting information with ohmd_set_data(). */
@@ -144,8 +172,56 @@ typedef enum {
 	/** int[1] (set, default: 1): Set this to 0 to prevent OpenHMD from creating background threads to do automatic device ticking.
 	    Call ohmd_update(); must be called frequently, at least 10 times per second, if the background threads are disabled. */
 	OHMD_IDS_AUTOMATIC_UPDATE = 0,
+
+	/** int[1] (set, default: OHMD_UPDATE_MODE_SHARED): Which background thread updates the device when automatic
+	    updating is enabled, one of the ohmd_update_mode values. */
+	OHMD_IDS_UPDATE_MODE = 1,
+
+	/** int[1] (set, default: 0): Fixed rate, in Hz, of a dedicated update thread. 0 updates the device as soon as it
+	    has new data. Ignored for devices on the shared update thread. */
+	OHMD_IDS_UPDATE_RATE = 2,
+
+	/** int[1] (set, default: -1): Zero indexed CPU core a dedicated update thread is pinned to, or -1 to let the
+	    system schedule it freely. Ignored for devices on the shared update thread, and on platforms without
+	    support for thread affinity. */
+	OHMD_IDS_UPDATE_CPU = 3,
 } ohmd_int_settings;
 
+typedef enum {
+	/** int[1] (set, default: OHMD_DRV_ALL): Bitwise or of the ohmd_driver_flags of the drivers the context uses.
+	    Drivers that are left out, or were not compiled in, are never initialized or probed. */
+	OHMD_ICS_DRIVERS = 0,
+
+	/** int[1] (set, default: 0): Set this to 1 to initialize the drivers on the first probe instead of when the
+	    context is created. */
+	OHMD_ICS_LAZY_DRIVERS = 1,
+} ohmd_int_ctx_settings;
+
+/** Drivers that can be selected with OHMD_ICS_DRIVERS. */
+typedef enum {
+	OHMD_DRV_OCULUS_RIFT = 1 << 0,
+	OHMD_DRV_EXTERNAL    = 1 << 1,
+	OHMD_DRV_ANDROID     = 1 << 2,
+	OHMD_DRV_DUMMY       = 1 << 3,
+	OHMD_DRV_REPLAY      = 1 << 4,
+
+	OHMD_DRV_ALL         = 0xffff,
+} ohmd_driver_flags;
+
+/** Update modes, used with OHMD_IDS_UPDATE_MODE. */
+typedef enum {
+	/** The device is updated by a background thread shared by all devices in the context. */
+	OHMD_UPDATE_MODE_SHARED = 0,
+	/** The device gets a background thread of its own. */
+	OHMD_UPDATE_MODE_DEDICATED = 1,
+} ohmd_update_mode;
+
+/** Changes to the device list, reported by hotplug monitoring. */
+typedef enum {
+	OHMD_HOTPLUG_ADDED   = 0,
+	OHMD_HOTPLUG_REMOVED = 1,
+} ohmd_hotplug_event;
+
 /** An opaque pointer to a context structure. */
 typedef struct ohmd_context ohmd_context;
 
@@ -155,6 +231,60 @@ typedef struct ohmd_device ohmd_device;
 /** An opaque pointer to a structure representing arguments for a device. */
 typedef struct ohmd_device_settings ohmd_device_settings;
 
+/** An opaque pointer to a structure representing arguments for a context. */
+typedef struct ohmd_ctx_settings ohmd_ctx_settings;
+
+/**
+ * Everything needed to render a stereo frame, see ohmd_device_get_frame.
+ *
+ * The matrices are column major OpenGL matrices and come first, so the start of the structure up to and
+ * including position matches a std140 uniform block of four mat4 and two vec4 members.
+ **/
+typedef struct {
+	float modelview_left[16];
+	float modelview_right[16];
+	float projection_left[16];
+	float projection_right[16];
+	/** The rotation quaternion (x, y, z, w) the modelview matrices were built from. */
+	float rotation[4];
+	/** The position (x, y, z), the fourth member is always 1. */
+	float position[4];
+	/** The time of the newest sensor sample, on the clock returned by ohmd_get_time, 0 if there is none. */
+	double time;
+	/** The number of the newest sensor sample, as returned by ohmd_device_wait_for_sample. */
+	unsigned int sample;
+} ohmd_frame;
+
+/**
+ * A function called when a device appears in or disappears from the device list, see ohmd_ctx_start_hotplug.
+ *
+ * @param ctx The context whose device list changed.
+ * @param event Whether the device was added or removed.
+ * @param id The id of the device, see ohmd_list_get_id.
+ * @param user_data The pointer given to ohmd_ctx_start_hotplug.
+ **/
+typedef void (OHMD_APIENTRY *ohmd_hotplug_callback)(ohmd_context* ctx, ohmd_hotplug_event event, int id, void* user_data);
+
+/**
+ * A function called when an asynchronous probe has finished, see ohmd_ctx_probe_async.
+ *
+ * @param ctx The probed context.
+ * @param num_devices The number of devices found on the system.
+ * @param user_data The pointer given to ohmd_ctx_probe_async.
+ **/
+typedef void (OHMD_APIENTRY *ohmd_probe_callback)(ohmd_context* ctx, int num_devices, void* user_data);
+
+/**
+ * A function called for every new sensor sample of a device, see ohmd_device_set_pose_callback.
+ *
+ * @param device The device the sample belongs to.
+ * @param time The time the sample was taken, on the clock returned by ohmd_get_time.
+ * @param rotation A float[4] holding the fused rotation of the sample, corrected like OHMD_ROTATION_QUAT.
+ * @param position A float[3] holding the current position, as OHMD_POSITION_VECTOR reports it.
+ * @param user_data The pointer given to ohmd_device_set_pose_callback.
+ **/
+typedef void (OHMD_APIENTRY *ohmd_pose_callback)(ohmd_device* device, double time, const float* rotation, const float* position, void* user_data);
+
 /**
  * Create an OpenHMD context.
  *
@@ -162,6 +292,39 @@ typedef struct ohmd_device_settings ohmd_device_settings;
  **/
 OHMD_APIENTRYDLL ohmd_context* OHMD_APIENTRY ohmd_ctx_create(void);
 
+/**
+ * Create an OpenHMD context with additional settings provided.
+ *
+ * Like ohmd_ctx_create, but lets the caller choose which drivers are used and when they are initialized.
+ *
+ * @param settings A pointer to a context settings struct, or NULL for the defaults of ohmd_ctx_create.
+ * @return a pointer to an allocated ohmd_context on success or NULL if it fails.
+ **/
+OHMD_APIENTRYDLL ohmd_context* OHMD_APIENTRY ohmd_ctx_create_ex(const ohmd_ctx_settings* settings);
+
+/**
+ * Create a context settings instance.
+ *
+ * @return a pointer to an allocated ohmd_ctx_settings on success or NULL if it fails.
+ **/
+OHMD_APIENTRYDLL ohmd_ctx_settings* OHMD_APIENTRY ohmd_ctx_settings_create(void);
+
+/**
+ * Specify int settings in a context settings struct.
+ *
+ * @param settings The context settings struct to set values to.
+ * @param key The specific setting you wish to set.
+ * @param val A pointer to an int or int array (containing the expected number of elements) with the value(s) you wish to set.
+ **/
+OHMD_APIENTRYDLL ohmd_status OHMD_APIENTRY ohmd_ctx_settings_seti(ohmd_ctx_settings* settings, ohmd_int_ctx_settings key, const int* val);
+
+/**
+ * Destroy a context settings instance.
+ *
+ * @param settings The context settings instance to destroy.
+ **/
+OHMD_APIENTRYDLL void OHMD_APIENTRY ohmd_ctx_settings_destroy(ohmd_ctx_settings* settings);
+
 /**
  * Destroy an OpenHMD context.
  *
@@ -202,12 +365,70 @@ OHMD_APIENTRYDLL void OHMD_APIENTRY ohmd_ctx_update(ohmd_context* ctx);
  * Probe for devices.
  *
  * Probes for and enumerates supported devices attached to the system.
+ * Devices that were already found by an earlier probe keep their id, see ohmd_list_get_id.
+ *
+ * This is ohmd_ctx_probe_async followed by waiting for it to finish.
  *
  * @param ctx A context with no currently open devices.
  * @return the number of devices found on the system.
  **/
 OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_ctx_probe(ohmd_context* ctx);
 
+/**
+ * Probe for devices in the background.
+ *
+ * Starts probing like ohmd_ctx_probe does and returns right away. The drivers enumerate their devices in
+ * parallel, and the device list is replaced once all of them are done. Completion is reported to the
+ * callback, from a background thread, and to ohmd_ctx_wait_probe.
+ *
+ * Only one probe runs at a time, starting another one first waits for the running one to finish.
+ * For that reason a probe can't be started from the callback, which fails with OHMD_S_INVALID_PARAMETER.
+ *
+ * @param ctx A context with no currently open devices.
+ * @param callback A function to call when the probe has finished, or NULL.
+ * @param user_data A pointer passed on to the callback.
+ * @return 0 on success, <0 on failure.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_ctx_probe_async(ohmd_context* ctx, ohmd_probe_callback callback, void* user_data);
+
+/**
+ * Wait for a probe started with ohmd_ctx_probe_async to finish.
+ *
+ * @param ctx The probed context.
+ * @param timeout The longest time to wait, in seconds.
+ * @return the number of devices found on the system, or OHMD_S_TIMEOUT if the probe is still running.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_ctx_wait_probe(ohmd_context* ctx, double timeout);
+
+/**
+ * Start monitoring the system for devices being plugged in or removed.
+ *
+ * A background thread keeps the device list up to date, only enumerating devices again when the
+ * operating system reports a change, and calls the callback for every device added to or removed
+ * from the list. The list is probed once right away, which reports every device that was not in
+ * it yet as added. ohmd_ctx_probe reports its changes to the callback as well.
+ *
+ * While monitoring, the list and the indices into it can change at any time, so devices should be
+ * looked up by their id with ohmd_list_find_id right before they are used.
+ *
+ * Only supported on Linux, where hidraw device nodes are watched. The devices of a removed node are
+ * dropped from the list right away, and only the drivers of HID devices are enumerated when one is added.
+ *
+ * @param ctx The context to monitor devices for.
+ * @param callback The function to call for changes, called from the monitoring thread or the thread calling
+ *        ohmd_ctx_probe, without any OpenHMD locks held.
+ * @param user_data A pointer passed on to the callback.
+ * @return 0 on success, OHMD_S_UNSUPPORTED if it can't be done on this platform, <0 on other failures.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_ctx_start_hotplug(ohmd_context* ctx, ohmd_hotplug_callback callback, void* user_data);
+
+/**
+ * Stop monitoring the system for devices, see ohmd_ctx_start_hotplug.
+ *
+ * @param ctx The context to stop monitoring for.
+ **/
+OHMD_APIENTRYDLL void OHMD_APIENTRY ohmd_ctx_stop_hotplug(ohmd_context* ctx);
+
 /**
  * Get device description from enumeration list index.
  *
@@ -219,6 +440,9 @@ OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_ctx_probe(ohmd_context* ctx);
  *
  * ohmd_ctx_probe must be called before calling ohmd_list_gets.
  *
+ * The string is owned by the context and stays valid until the context is destroyed, even if
+ * the device list is probed again meanwhile. Strings of different devices can be held at once.
+ *
  * @param ctx A (probed) context.
  * @param index An index, between 0 and the value returned from ohmd_ctx_probe.
  * @param type The type of data to fetch. One of OHMD_VENDOR, OHMD_PRODUCT and OHMD_PATH.
@@ -226,6 +450,27 @@ OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_ctx_probe(ohmd_context* ctx);
  **/
 OHMD_APIENTRYDLL const char* OHMD_APIENTRY ohmd_list_gets(ohmd_context* ctx, int index, ohmd_string_value type);
 
+/**
+ * Get the id of a device in the enumeration list.
+ *
+ * Every device found by probing gets an id above 0 that it keeps for as long as it stays in the list,
+ * no matter how its index changes when other devices come and go.
+ *
+ * @param ctx A (probed) context.
+ * @param index An index, between 0 and the value returned from ohmd_ctx_probe.
+ * @return the id of the device, or <0 if the index is out of range.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_list_get_id(ohmd_context* ctx, int index);
+
+/**
+ * Find a device in the enumeration list by its id.
+ *
+ * @param ctx A (probed) context.
+ * @param id A device id, as returned by ohmd_list_get_id or passed to a hotplug callback.
+ * @return the current index of the device, or <0 if it is no longer in the list.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_list_find_id(ohmd_context* ctx, int id);
+
 /**
  * Open a device.
  *
@@ -257,6 +502,21 @@ OHMD_APIENTRYDLL ohmd_device* OHMD_APIENTRY ohmd_list_open_device(ohmd_context*
  **/
 OHMD_APIENTRYDLL ohmd_device* OHMD_APIENTRY ohmd_list_open_device_s(ohmd_context* ctx, int index, ohmd_device_settings* settings);
 
+/**
+ * Open several devices at once.
+ *
+ * Opens the devices at the given enumeration indices in parallel, which is faster than opening them
+ * one by one with ohmd_list_open_device_s as opening a device can involve blocking I/O.
+ *
+ * @param ctx A (probed) context.
+ * @param count The number of indices.
+ * @param indices The indices of the devices to open, as for ohmd_list_open_device.
+ * @param settings A pointer to a device settings struct used for all devices, or NULL for the defaults.
+ * @param out_devices An array of count pointers, receiving the opened devices, or NULL for devices that could not be opened.
+ * @return the number of devices opened.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_list_open_devices(ohmd_context* ctx, int count, const int* indices, ohmd_device_settings* settings, ohmd_device** out_devices);
+
 /**
  * Specify int settings in a device settings struct.
  *
@@ -287,8 +547,11 @@ OHMD_APIENTRYDLL void OHMD_APIENTRY ohmd_device_settings_destroy(ohmd_device_set
  * Closes a device opened by ohmd_list_open_device. Note that ohmd_ctx_destroy automatically closes any open devices
  * associated with the context being destroyed.
  *
+ * Closing waits for the threads updating the device to be done with it, so devices must not be closed from pose
+ * callbacks. On the automatic update threads this is detected and refused.
+ *
  * @param device The open device.
- * @return 0 on success, <0 on failure.
+ * @return 0 on success, OHMD_S_INVALID_PARAMETER if called from the thread updating the device, <0 on other failures.
  **/
 OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_close_device(ohmd_device* device);
 
@@ -303,6 +566,33 @@ OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_close_device(ohmd_device* device);
  **/
 OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_getf(ohmd_device* device, ohmd_float_value type, float* out);
 
+/**
+ * Get several floating point values from a device at once.
+ *
+ * All pose values (rotation, position and the modelview matrices) are taken from the same update of the
+ * device, so both eyes always agree on the rotation, and the device is locked at most once for the rest.
+ *
+ * @param device An open device to retrieve the values from.
+ * @param count The number of values to get.
+ * @param types An array of count value types, see ohmd_float_value section for more information.
+ * @param[out] out An array of count pointers, each to a float or float array that receives the matching value.
+ * @return 0 on success, otherwise the error of the first value that could not be retrieved, the other values
+ *         are still written.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_getf_multi(ohmd_device* device, int count, const ohmd_float_value* types, float* const* out);
+
+/**
+ * Get the view and projection matrices for both eyes, and the pose they were made from, in one call.
+ *
+ * All members come from the same update of the device, and like the pose values of ohmd_device_getf
+ * this never waits for the update thread.
+ *
+ * @param device An open device to retrieve the frame from.
+ * @param[out] out The frame to fill.
+ * @return 0 on success, <0 on failure.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_get_frame(ohmd_device* device, ohmd_frame* out);
+
 /**
  * Set a floating point value for a device.
  *
@@ -333,6 +623,81 @@ OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_geti(ohmd_device* device, ohmd_in
  **/
 OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_seti(ohmd_device* device, ohmd_int_value type, const int* in);
 
+/**
+ * Get the time of the newest sensor sample the pose of a device was built from.
+ *
+ * Together with OHMD_SAMPLE_NUMBER this tells how old the pose is, for example to measure the latency
+ * from sensor to display.
+ *
+ * @param device An open device to retrieve the time from.
+ * @param[out] out The time of the sample in seconds, on the clock returned by ohmd_get_time, or 0 if
+ *                 the device has not fused a sample yet.
+ * @return 0 on success, <0 on failure.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_get_sample_time(ohmd_device* device, double* out);
+
+/**
+ * Get the rotation of a device at a given point in time, past or future.
+ *
+ * Every device keeps a short history of its most recently fused sensor samples (the last 255 samples,
+ * roughly a quarter of a second for a 1000 Hz sensor). The rotation is interpolated between the samples
+ * taken around the given time, times before the oldest sample are clamped to it.
+ *
+ * Times after the newest sample are predicted from its angular velocity and the angular acceleration over
+ * the last few samples, which is how a renderer gets the rotation for when a frame will be displayed.
+ * Predictions are limited to 100 ms ahead of the newest sample.
+ *
+ * @param device An open device to retrieve the rotation from.
+ * @param time A point in time, in seconds, on the clock returned by ohmd_get_time.
+ * @param[out] out A float[4] where the rotation is written as a quaternion (x, y, z, w), corrected in the same
+ *             way as OHMD_ROTATION_QUAT.
+ * @return 0 on success, OHMD_S_UNSUPPORTED if the device has not reported any sensor samples.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_get_pose_at(ohmd_device* device, double time, float* out);
+
+/**
+ * Set a function to be called for every new sensor sample of a device.
+ *
+ * The callback is made from the thread that updated the device, the automatic update thread or the
+ * thread calling ohmd_ctx_update, after the update and without any OpenHMD locks held, so it may read
+ * from and set values in the device, but must not close it or any other device, see ohmd_close_device. Samples are delivered in order, samples
+ * that have left the history kept for ohmd_device_get_pose_at before the callback got to them are skipped.
+ *
+ * A callback that is already running may still be finishing when this function returns.
+ *
+ * @param device An open device to receive samples from.
+ * @param callback The function to call, or NULL to stop receiving samples.
+ * @param user_data A pointer passed on to the callback.
+ * @return 0 on success, <0 on failure.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_set_pose_callback(ohmd_device* device, ohmd_pose_callback callback, void* user_data);
+
+/**
+ * Wait for a new sensor sample of a device.
+ *
+ * Samples are numbered in the order the device fuses them, starting at 1. This blocks until the device has
+ * fused a sample newer than last_sample, which lets a caller run in lockstep with the sensor rate:
+ * pass 0 the first time and the number returned by the previous call after that.
+ *
+ * The device must not be closed while a thread is waiting on it.
+ *
+ * @param device An open device to wait on.
+ * @param last_sample The number of the newest sample the caller has seen.
+ * @param timeout The longest time to wait, in seconds.
+ * @param[out] out_sample The number of the newest sample, also written on timeout.
+ * @return 0 if there is a newer sample, OHMD_S_TIMEOUT if none arrived in time.
+ **/
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_device_wait_for_sample(ohmd_device* device, unsigned int last_sample, double timeout, unsigned int* out_sample);
+
+/**
+ * Get the current time.
+ *
+ * Returns the time of the clock OpenHMD timestamps sensor samples with.
+ *
+ * @return the current time in seconds, from an unspecified starting point.
+ **/
+OHMD_APIENTRYDLL double OHMD_APIENTRY ohmd_get_time(void);
+
 /**
  * Set an void* data value for a device.
  *
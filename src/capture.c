@@ -0,0 +1,228 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Raw Device Capture */
+
+#include <string.h>
+
+#include "openhmdi.h"
+
+// How often the writer thread writes out buffered records, in seconds
+#define CAPTURE_FLUSH_INTERVAL 0.1
+// Records are dropped rather than buffered beyond this, in bytes
+#define CAPTURE_MAX_BUFFERED (4 * 1024 * 1024)
+
+#define RECORD_HEADER_SIZE 12
+
+struct ohmd_capture {
+	FILE* file;
+
+	// records waiting to be written, guarded by mutex
+	ohmd_mutex* mutex;
+	unsigned char* buffer;
+	int buffer_size;
+	int num_allocated;
+	unsigned int num_dropped;
+
+	// the buffer being written, swapped with buffer by the writer thread
+	unsigned char* write_buffer;
+	int write_num_allocated;
+
+	ohmd_thread* thread;
+	ohmd_cond* cond;
+	volatile unsigned int quit;
+};
+
+static void flush_capture(ohmd_capture* capture)
+{
+	ohmd_lock_mutex(capture->mutex);
+
+	unsigned char* buffer = capture->buffer;
+	int size = capture->buffer_size;
+	int num_allocated = capture->num_allocated;
+
+	capture->buffer = capture->write_buffer;
+	capture->num_allocated = capture->write_num_allocated;
+	capture->buffer_size = 0;
+
+	ohmd_unlock_mutex(capture->mutex);
+
+	if(size > 0){
+		if(fwrite(buffer, size, 1, capture->file) != 1)
+			LOGW("could not write capture file");
+		fflush(capture->file);
+	}
+
+	capture->write_buffer = buffer;
+	capture->write_num_allocated = num_allocated;
+}
+
+static unsigned int capture_thread(void* arg)
+{
+	ohmd_capture* capture = (ohmd_capture*)arg;
+
+	while(!capture->quit){
+		ohmd_wait_cond(capture->cond, &capture->quit, 0, CAPTURE_FLUSH_INTERVAL);
+		flush_capture(capture);
+	}
+
+	return 0;
+}
+
+// takes over file, closing it on failure
+static ohmd_capture* create_capture(ohmd_context* ctx, FILE* file, const char* path, int revision)
+{
+	ohmd_capture* capture = ohmd_alloc(ctx, sizeof(ohmd_capture));
+	if(!capture){
+		fclose(file);
+		return NULL;
+	}
+
+	capture->file = file;
+
+	uint32_t magic = OHMD_CAPTURE_MAGIC;
+	uint16_t version = OHMD_CAPTURE_VERSION, rev = (uint16_t)revision;
+
+	if(fwrite(&magic, sizeof(magic), 1, capture->file) != 1 ||
+	   fwrite(&version, sizeof(version), 1, capture->file) != 1 ||
+	   fwrite(&rev, sizeof(rev), 1, capture->file) != 1){
+		ohmd_set_error(ctx, "could not write capture file %s", path);
+		goto cleanup;
+	}
+
+	capture->mutex = ohmd_create_mutex(ctx);
+	capture->cond = ohmd_create_cond(ctx);
+	if(!capture->mutex || !capture->cond)
+		goto cleanup;
+
+	capture->thread = ohmd_create_thread(ctx, capture_thread, capture);
+	if(!capture->thread){
+		ohmd_set_error(ctx, "could not create capture thread");
+		goto cleanup;
+	}
+
+	return capture;
+
+cleanup:
+	if(capture->file)
+		fclose(capture->file);
+	if(capture->mutex)
+		ohmd_destroy_mutex(capture->mutex);
+	if(capture->cond)
+		ohmd_destroy_cond(capture->cond);
+	free(capture);
+
+	return NULL;
+}
+
+ohmd_capture* ohmd_create_capture(ohmd_context* ctx, const char* path, int revision)
+{
+	FILE* file = fopen(path, "wb");
+	if(!file){
+		ohmd_set_error(ctx, "could not open capture file %s", path);
+		return NULL;
+	}
+
+	return create_capture(ctx, file, path, revision);
+}
+
+ohmd_capture* ohmd_create_new_capture(ohmd_context* ctx, const char* path, int revision, bool* exists)
+{
+	FILE* file = ohmd_create_new_file(path, exists);
+	if(!file){
+		ohmd_set_error(ctx, *exists ? "capture file %s already exists" : "could not create capture file %s", path);
+		return NULL;
+	}
+
+	return create_capture(ctx, file, path, revision);
+}
+
+void ohmd_capture_write(ohmd_capture* capture, ohmd_capture_type type, double time, const unsigned char* data, int size)
+{
+	size = OHMD_MIN(size, OHMD_CAPTURE_MAX_REPORT_SIZE);
+
+	ohmd_lock_mutex(capture->mutex);
+
+	int record_size = RECORD_HEADER_SIZE + size;
+	int new_size = capture->buffer_size + record_size;
+
+	if(new_size > CAPTURE_MAX_BUFFERED ||
+	   !ohmd_grow_array((void**)&capture->buffer, &capture->num_allocated, new_size, 1)){
+		capture->num_dropped++;
+		ohmd_unlock_mutex(capture->mutex);
+		return;
+	}
+
+	unsigned char* record = capture->buffer + capture->buffer_size;
+	uint16_t record_data_size = (uint16_t)size;
+
+	memcpy(record, &time, 8);
+	memcpy(record + 8, &record_data_size, 2);
+	record[10] = (unsigned char)type;
+	record[11] = 0;
+	memcpy(record + RECORD_HEADER_SIZE, data, size);
+
+	capture->buffer_size = new_size;
+
+	ohmd_unlock_mutex(capture->mutex);
+}
+
+void ohmd_destroy_capture(ohmd_capture* capture)
+{
+	capture->quit = 1;
+	ohmd_signal_cond(capture->cond);
+	ohmd_destroy_thread(capture->thread);
+
+	// anything written after the last flush of the thread
+	flush_capture(capture);
+
+	if(capture->num_dropped > 0)
+		LOGW("%u records were dropped from the capture", capture->num_dropped);
+
+	fclose(capture->file);
+	ohmd_destroy_cond(capture->cond);
+	ohmd_destroy_mutex(capture->mutex);
+	free(capture->buffer);
+	free(capture->write_buffer);
+	free(capture);
+}
+
+bool ohmd_capture_read_header(FILE* file, int* revision)
+{
+	uint32_t magic;
+	uint16_t version, rev;
+
+	if(fread(&magic, sizeof(magic), 1, file) != 1 ||
+	   fread(&version, sizeof(version), 1, file) != 1 ||
+	   fread(&rev, sizeof(rev), 1, file) != 1)
+		return false;
+
+	if(magic != OHMD_CAPTURE_MAGIC || version != OHMD_CAPTURE_VERSION)
+		return false;
+
+	*revision = rev;
+	return true;
+}
+
+bool ohmd_capture_read_record(FILE* file, ohmd_capture_record* record)
+{
+	unsigned char header[RECORD_HEADER_SIZE];
+	uint16_t size;
+
+	if(fread(header, RECORD_HEADER_SIZE, 1, file) != 1)
+		return false;
+
+	memcpy(&record->time, header, 8);
+	memcpy(&size, header + 8, 2);
+	record->type = (ohmd_capture_type)header[10];
+	record->size = size;
+
+	if(size > OHMD_CAPTURE_MAX_REPORT_SIZE)
+		return false;
+
+	return size == 0 || fread(record->data, size, 1, file) == 1;
+}
@@ -0,0 +1,56 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Raw Device Capture */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "openhmd.h"
+
+// A capture file is a header followed by records, in host byte order:
+//
+//   header: uint32 magic, uint16 version, uint16 revision of the captured device
+//   record: double time, uint16 size, uint8 type, uint8 unused, then size bytes of report data
+//
+// Times are host times in seconds, see ohmd_get_tick.
+
+#define OHMD_CAPTURE_MAGIC 0x5043484f // "OHCP"
+#define OHMD_CAPTURE_VERSION 1
+#define OHMD_CAPTURE_MAX_REPORT_SIZE 256
+
+typedef enum {
+	OHMD_CAPTURE_INPUT_REPORT = 0,
+	OHMD_CAPTURE_FEATURE_REPORT = 1,
+} ohmd_capture_type;
+
+typedef struct {
+	double time;
+	ohmd_capture_type type;
+	int size;
+	unsigned char data[OHMD_CAPTURE_MAX_REPORT_SIZE];
+} ohmd_capture_record;
+
+typedef struct ohmd_capture ohmd_capture;
+
+// records are buffered in memory and written to the file on a background thread,
+// so ohmd_capture_write never waits for the disk
+ohmd_capture* ohmd_create_capture(ohmd_context* ctx, const char* path, int revision);
+// likewise, but fails instead of overwriting an existing file, exists is set if that's why NULL was returned
+ohmd_capture* ohmd_create_new_capture(ohmd_context* ctx, const char* path, int revision, bool* exists);
+void ohmd_capture_write(ohmd_capture* capture, ohmd_capture_type type, double time, const unsigned char* data, int size);
+// writes out anything still buffered
+void ohmd_destroy_capture(ohmd_capture* capture);
+
+bool ohmd_capture_read_header(FILE* file, int* revision);
+// returns false at the end of the file
+bool ohmd_capture_read_record(FILE* file, ohmd_capture_record* record);
+
+#endif
@@ -83,6 +83,8 @@ static int android_sensor_callback(int fd, int events, void* data)
             else
                 ofusion_update(&priv->sensor_fusion, dT, &gyro, &accel, &mag); //default
 
+            ohmd_device_push_sample(&priv->base, ohmd_get_tick(), &priv->sensor_fusion.orient, &priv->sensor_fusion.ang_vel);
+
             timestamp = lastevent_timestamp;
     }
     return 1;
@@ -203,6 +205,7 @@ static ohmd_device* open_device(ohmd_driver* driver, ohmd_device_desc* desc)
 	priv->base.update = update_device;
 	priv->base.close = close_device;
 	priv->base.getf = getf;
+	priv->base.driver_float_values = 1 << OHMD_DISTORTION_K;
 	priv->base.set_data = set_data;
 
     //init Android sensors
@@ -225,7 +228,9 @@ static ohmd_device* open_device(ohmd_driver* driver, ohmd_device_desc* desc)
 
 static void get_device_list(ohmd_driver* driver, ohmd_device_list* list)
 {
-	ohmd_device_desc* desc = &list->devices[list->num_devices++];
+	ohmd_device_desc* desc = ohmd_device_list_add(list);
+	if(!desc)
+		return;
 
 	strcpy(desc->driver, "OpenHMD Generic Android Driver");
 	strcpy(desc->vendor, "OpenHMD");
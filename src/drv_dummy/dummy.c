@@ -78,13 +78,16 @@ static ohmd_device* open_device(ohmd_driver* driver, ohmd_device_desc* desc)
 	priv->base.update = update_device;
 	priv->base.close = close_device;
 	priv->base.getf = getf;
+	priv->base.driver_float_values = 1 << OHMD_DISTORTION_K;
 	
 	return (ohmd_device*)priv;
 }
 
 static void get_device_list(ohmd_driver* driver, ohmd_device_list* list)
 {
-	ohmd_device_desc* desc = &list->devices[list->num_devices++];
+	ohmd_device_desc* desc = ohmd_device_list_add(list);
+	if(!desc)
+		return;
 
 	strcpy(desc->driver, "OpenHMD Dummy Driver");
 	strcpy(desc->vendor, "OpenHMD");
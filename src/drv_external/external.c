@@ -50,6 +50,7 @@ static int setf(ohmd_device* device, ohmd_float_value type, const float* in)
 	switch(type){
 		case OHMD_EXTERNAL_SENSOR_FUSION: {
 				ofusion_update(&priv->sensor_fusion, *in, (vec3f*)(in + 1), (vec3f*)(in + 4), (vec3f*)(in + 7));
+				ohmd_device_push_sample(device, ohmd_get_tick(), &priv->sensor_fusion.orient, &priv->sensor_fusion.ang_vel);
 			}
 			break;
 
@@ -105,7 +106,9 @@ static ohmd_device* open_device(ohmd_driver* driver, ohmd_device_desc* desc)
 
 static void get_device_list(ohmd_driver* driver, ohmd_device_list* list)
 {
-	ohmd_device_desc* desc = &list->devices[list->num_devices++];
+	ohmd_device_desc* desc = ohmd_device_list_add(list);
+	if(!desc)
+		return;
 
 	strcpy(desc->driver, "OpenHMD Generic External Driver");
 	strcpy(desc->vendor, "OpenHMD");
@@ -8,6 +8,7 @@
 /* Oculus Rift Driver - Packet Decoding and Utilities */
 
 #include <stdio.h>
+#include <string.h>
 #include "rift.h"
 
 #define SKIP_CMD (buffer++)
@@ -136,6 +137,60 @@ void vec3f_from_rift_vec(const int32_t* smp, vec3f* out_vec)
 	out_vec->z = (float)smp[2] * 0.0001f;
 }
 
+// the inverse of vec3f_from_rift_vec
+void rift_vec_from_vec3f(const vec3f* vec, int32_t* out_smp)
+{
+	out_smp[0] = (int32_t)(vec->x * 10000.0f);
+	out_smp[1] = (int32_t)(vec->y * 10000.0f);
+	out_smp[2] = (int32_t)(vec->z * 10000.0f);
+}
+
+static void encode_sample(const int32_t* smp, unsigned char* buffer)
+{
+	// the inverse of decode_sample, 3 21 bit values packed into 8 bytes
+	uint32_t x = smp[0] & 0x1fffff;
+	uint32_t y = smp[1] & 0x1fffff;
+	uint32_t z = smp[2] & 0x1fffff;
+
+	buffer[0] = x >> 13;
+	buffer[1] = x >> 5;
+	buffer[2] = ((x & 0x1f) << 3) | (y >> 18);
+	buffer[3] = y >> 10;
+	buffer[4] = y >> 2;
+	buffer[5] = ((y & 0x03) << 6) | (z >> 15);
+	buffer[6] = z >> 7;
+	buffer[7] = (z & 0x7f) << 1;
+}
+
+// the inverse of decode_tracker_sensor_msg, as the device sends it, used to emulate and replay devices
+int encode_tracker_sensor_msg(unsigned char* buffer, const pkt_tracker_sensor* msg)
+{
+	memset(buffer, 0, 62);
+
+	WRITE8(RIFT_IRQ_SENSORS);
+	WRITE8(msg->num_samples);
+	WRITE16(msg->timestamp);
+	WRITE16(msg->last_command_id);
+	WRITE16(msg->temperature);
+
+	int actual = OHMD_MIN(msg->num_samples, 3);
+	for(int i = 0; i < actual; i++){
+		encode_sample(msg->samples[i].accel, buffer);
+		buffer += 8;
+
+		encode_sample(msg->samples[i].gyro, buffer);
+		buffer += 8;
+	}
+
+	// Leave empty samples zeroed
+	buffer += (3 - actual) * 16;
+	for(int i = 0; i < 3; i++){
+		WRITE16(msg->mag[i]);
+	}
+
+	return 62; // tracker sensor message size
+}
+
 int encode_sensor_config(unsigned char* buffer, const pkt_sensor_config* config)
 {
 	WRITE8(RIFT_CMD_SENSOR_CONFIG);
@@ -216,3 +271,77 @@ void dump_packet_tracker_sensor(const pkt_tracker_sensor* sensor)
 		LOGD("    gyro:  %d %d %d", sensor->samples[i].gyro[0], sensor->samples[i].gyro[1], sensor->samples[i].gyro[2]);
 	}
 }
+
+// The timestamp of a message is the sample counter value of its first sample, it advances by
+// exactly one per sample, so the timestamp delta over the samples of a message is always one
+// tick. The sensors sample at a fixed 1000 Hz, the timestamps only change dt where they show
+// samples missing between messages or left out of one.
+#define TICK_LEN (1.0f / 1000.0f) // 1000 Hz ticks
+// Longer gaps in the timestamps aren't bridged with the last known motion,
+// the device has most likely been reset or stalled
+#define MAX_MISSED_SAMPLES 254
+
+void rift_tracker_init(rift_tracker* tracker)
+{
+	memset(tracker, 0, sizeof(rift_tracker));
+	ofusion_init(&tracker->sensor_fusion);
+}
+
+// Checks the timestamp of the message against the previous one, and fuses
+// the last known motion over any samples that went missing in between.
+static void handle_missed_samples(rift_tracker* tracker, const pkt_tracker_sensor* s)
+{
+	if(tracker->have_timestamp){
+		// the timestamps are 16 bit sample counters, wrapping around every ~65 seconds
+		uint16_t expected = tracker->last_timestamp + tracker->last_num_samples;
+		uint16_t missed = s->timestamp - expected;
+
+		// anything in the upper half is a timestamp going backwards, not a gap
+		if(missed > 0 && missed < 0x8000){
+			tracker->dropped_samples += missed;
+
+			if(missed <= MAX_MISSED_SAMPLES){
+				ofusion_update(&tracker->sensor_fusion, missed * TICK_LEN,
+					&tracker->raw_gyro, &tracker->raw_accel, &tracker->raw_mag);
+			}else{
+				LOGW("%u samples missed, not fusing over them", missed);
+			}
+		}
+	}
+
+	tracker->have_timestamp = true;
+	tracker->last_timestamp = s->timestamp;
+	tracker->last_num_samples = s->num_samples;
+}
+
+void rift_tracker_handle_msg(rift_tracker* tracker, ohmd_device* device, const pkt_tracker_sensor* s, double time)
+{
+	dump_packet_tracker_sensor(s);
+
+	handle_missed_samples(tracker, s);
+
+	// a message carries at most the three newest samples, the oldest one
+	// stands in for any samples before it that didn't fit
+	int num_samples = OHMD_MIN(s->num_samples, 3);
+	if(s->num_samples > 3)
+		tracker->late_samples += s->num_samples - 3;
+
+	// the first sample is the oldest carried one, a tick after the last one fused unless samples were left out
+	float dt = s->num_samples > 3 ? (s->num_samples - 2) * TICK_LEN : TICK_LEN;
+
+	int32_t mag32[] = { s->mag[0], s->mag[1], s->mag[2] };
+	vec3f_from_rift_vec(mag32, &tracker->raw_mag);
+
+	// the last sample in the message is the most recent one
+	for(int i = 0; i < num_samples; i++){
+		vec3f_from_rift_vec(s->samples[i].accel, &tracker->raw_accel);
+		vec3f_from_rift_vec(s->samples[i].gyro, &tracker->raw_gyro);
+
+		ofusion_update(&tracker->sensor_fusion, dt, &tracker->raw_gyro, &tracker->raw_accel, &tracker->raw_mag);
+		ohmd_device_push_sample(device, time - (num_samples - 1 - i) * TICK_LEN,
+			&tracker->sensor_fusion.orient, &tracker->sensor_fusion.ang_vel);
+
+		// the rest of the samples are a tick apart
+		dt = TICK_LEN;
+	}
+}
@@ -13,25 +13,70 @@
 #include <stdio.h>
 #include <time.h>
 #include <assert.h>
+#include <ctype.h>
 
 #include "rift.h"
 
-#define TICK_LEN (1.0f / 1000.0f) // 1000 Hz ticks
 #define KEEP_ALIVE_VALUE (10 * 1000)
 #define SETFLAG(_s, _flag, _val) (_s) = ((_s) & ~(_flag)) | ((_val) ? (_flag) : 0)
 
+// Sensor reports queued between the reader thread and update_device, a power of two
+#define REPORT_RING_SIZE 64
+// How long the reader thread blocks on the device before checking if it should quit, in ms
+#define READER_TIMEOUT_MS 100
+
+// directory for the config cache, caching is disabled when it's not set
+#define CACHE_DIR_ENV "OPENHMD_CACHE_DIR"
+// directory raw reports are captured to, see capture.h, capturing is disabled when it's not set
+#define CAPTURE_DIR_ENV "OPENHMD_CAPTURE_DIR"
+// bump when rift_config changes
+#define CACHE_MAGIC 0x4f524331
+
+// everything open_device reads from the device, cached between runs
+typedef struct {
+	pkt_sensor_range range;
+	pkt_sensor_display_info display_info;
+	pkt_sensor_config sensor_config;
+	rift_coordinate_frame hw_coordinate_frame;
+} rift_config;
+
+typedef struct {
+	pkt_tracker_sensor sensor;
+	double time; // host time the report was read
+} rift_report;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t size;
+	rift_config config;
+} rift_cache_record;
+
 typedef struct {
 	ohmd_device base;
 
 	hid_device* handle;
+	ohmd_mutex* feature_mutex; // one feature report at a time, verify_config and update_device both send them
 	pkt_sensor_range sensor_range;
 	pkt_sensor_display_info display_info;
 	rift_coordinate_frame coordinate_frame, hw_coordinate_frame;
 	pkt_sensor_config sensor_config;
-	pkt_tracker_sensor sensor;
 	double last_keep_alive;
-	fusion sensor_fusion;
-	vec3f raw_mag, raw_accel, raw_gyro;
+	rift_tracker tracker;
+
+	// sensor reports read by reader_thread and fused by update_device
+	ohmd_thread* reader_thread;
+	volatile bool reader_quit;
+	ohmd_ring* reports;
+
+	// every report read from the device, if capturing
+	ohmd_capture* capture;
+
+	// when opened from the cache the device is read again in the background,
+	// update_device picks up verified_config once verify_done is set
+	char cache_path[OHMD_STR_SIZE * 2];
+	rift_config cached_config, verified_config;
+	ohmd_thread* verify_thread;
+	volatile bool verify_done;
 } rift_priv;
 
 static rift_priv* rift_priv_get(ohmd_device* device)
@@ -43,26 +88,36 @@ static int get_feature_report(rift_priv* priv, rift_sensor_feature_cmd cmd, unsi
 {
 	memset(buf, 0, FEATURE_BUFFER_SIZE);
 	buf[0] = (unsigned char)cmd;
-	return hid_get_feature_report(priv->handle, buf, FEATURE_BUFFER_SIZE);
+
+	ohmd_lock_mutex(priv->feature_mutex);
+	int size = hid_get_feature_report(priv->handle, buf, FEATURE_BUFFER_SIZE);
+	ohmd_unlock_mutex(priv->feature_mutex);
+
+	if(priv->capture && size > 0)
+		ohmd_capture_write(priv->capture, OHMD_CAPTURE_FEATURE_REPORT, ohmd_get_tick(), buf, size);
+
+	return size;
 }
 
 static int send_feature_report(rift_priv* priv, const unsigned char *data, size_t length)
 {
-	return hid_send_feature_report(priv->handle, data, length);
+	ohmd_lock_mutex(priv->feature_mutex);
+	int ret = hid_send_feature_report(priv->handle, data, length);
+	ohmd_unlock_mutex(priv->feature_mutex);
+
+	return ret;
 }
 
-static void set_coordinate_frame(rift_priv* priv, rift_coordinate_frame coordframe)
+static void set_coordinate_frame(rift_priv* priv, rift_config* config, rift_coordinate_frame coordframe)
 {
-	priv->coordinate_frame = coordframe;
-
 	// set the RIFT_SCF_SENSOR_COORDINATES in the sensor config to match whether coordframe is hmd or sensor
-	SETFLAG(priv->sensor_config.flags, RIFT_SCF_SENSOR_COORDINATES, coordframe == RIFT_CF_SENSOR);
+	SETFLAG(config->sensor_config.flags, RIFT_SCF_SENSOR_COORDINATES, coordframe == RIFT_CF_SENSOR);
 
 	// encode send the new config to the Rift 
 	unsigned char buf[FEATURE_BUFFER_SIZE];
-	int size = encode_sensor_config(buf, &priv->sensor_config);
+	int size = encode_sensor_config(buf, &config->sensor_config);
 	if(send_feature_report(priv, buf, size) == -1){
-		ohmd_set_error(priv->base.ctx, "send_feature_report failed in set_coordinate frame");
+		LOGE("send_feature_report failed in set_coordinate frame");
 		return;
 	}
 
@@ -71,44 +126,275 @@ static void set_coordinate_frame(rift_priv* priv, rift_coordinate_frame coordfra
 	size = get_feature_report(priv, RIFT_CMD_SENSOR_CONFIG, buf);
 	if(size <= 0){
 		LOGW("could not set coordinate frame");
-		priv->hw_coordinate_frame = RIFT_CF_HMD;
+		config->hw_coordinate_frame = RIFT_CF_HMD;
 		return;
 	}
 
-	decode_sensor_config(&priv->sensor_config, buf, size);
-	priv->hw_coordinate_frame = (priv->sensor_config.flags & RIFT_SCF_SENSOR_COORDINATES) ? RIFT_CF_SENSOR : RIFT_CF_HMD;
+	decode_sensor_config(&config->sensor_config, buf, size);
+	config->hw_coordinate_frame = (config->sensor_config.flags & RIFT_SCF_SENSOR_COORDINATES) ? RIFT_CF_SENSOR : RIFT_CF_HMD;
 
-	if(priv->hw_coordinate_frame != coordframe) {
+	if(config->hw_coordinate_frame != coordframe) {
 		LOGW("coordinate frame didn't stick");
 	}
 }
 
-static void handle_tracker_sensor_msg(rift_priv* priv, unsigned char* buffer, int size)
+static rift_coordinate_frame get_coordinate_frame(const rift_config* config)
+{
+	// if the sensor has display info data, use HMD coordinate frame
+	return config->display_info.distortion_type != RIFT_DT_NONE ? RIFT_CF_HMD : RIFT_CF_SENSOR;
+}
+
+// All the feature report round trips needed to set up the device.
+static void read_config(rift_priv* priv, rift_config* config)
+{
+	unsigned char buf[FEATURE_BUFFER_SIZE];
+	int size;
+
+	memset(config, 0, sizeof(rift_config));
+
+	// Read and decode the sensor range
+	size = get_feature_report(priv, RIFT_CMD_RANGE, buf);
+	decode_sensor_range(&config->range, buf, size);
+	dump_packet_sensor_range(&config->range);
+
+	// Read and decode display information
+	size = get_feature_report(priv, RIFT_CMD_DISPLAY_INFO, buf);
+	decode_sensor_display_info(&config->display_info, buf, size);
+	dump_packet_sensor_display_info(&config->display_info);
+
+	// Read and decode the sensor config
+	size = get_feature_report(priv, RIFT_CMD_SENSOR_CONFIG, buf);
+	decode_sensor_config(&config->sensor_config, buf, size);
+	dump_packet_sensor_config(&config->sensor_config);
+
+	// enable calibration
+	SETFLAG(config->sensor_config.flags, RIFT_SCF_USE_CALIBRATION, 1);
+	SETFLAG(config->sensor_config.flags, RIFT_SCF_AUTO_CALIBRATION, 1);
+
+	// apply sensor config
+	set_coordinate_frame(priv, config, get_coordinate_frame(config));
+
+	// set keep alive interval to n seconds
+	pkt_keep_alive keep_alive = { 0, KEEP_ALIVE_VALUE };
+	size = encode_keep_alive(buf, &keep_alive);
+	send_feature_report(priv, buf, size);
+
+	// update sensor settings with new keep alive value
+	// (which will have been ignored in favor of the default 1000 ms one)
+	size = get_feature_report(priv, RIFT_CMD_SENSOR_CONFIG, buf);
+	decode_sensor_config(&config->sensor_config, buf, size);
+	dump_packet_sensor_config(&config->sensor_config);
+
+	// the command ids differ between reads, keep them out of comparisons
+	config->range.command_id = 0;
+	config->display_info.command_id = 0;
+	config->sensor_config.command_id = 0;
+}
+
+static void apply_config(rift_priv* priv, const rift_config* config)
+{
+	priv->sensor_range = config->range;
+	priv->display_info = config->display_info;
+	priv->sensor_config = config->sensor_config;
+	priv->hw_coordinate_frame = config->hw_coordinate_frame;
+	priv->coordinate_frame = get_coordinate_frame(config);
+
+	// Set device properties
+	priv->base.properties.hsize = priv->display_info.h_screen_size;
+	priv->base.properties.vsize = priv->display_info.v_screen_size;
+	priv->base.properties.hres = priv->display_info.h_resolution;
+	priv->base.properties.vres = priv->display_info.v_resolution;
+	priv->base.properties.lens_sep = priv->display_info.lens_separation;
+	priv->base.properties.lens_vpos = priv->display_info.v_center;
+	priv->base.properties.fov = DEG_TO_RAD(125.5144f); // TODO calculate.
+	priv->base.properties.ratio = ((float)priv->display_info.h_resolution / (float)priv->display_info.v_resolution) / 2.0f;
+
+	// calculate projection eye projection matrices from the device properties
+	ohmd_calc_default_proj_matrices(&priv->base.properties);
+}
+
+// Builds dir/rift-<revision>-<key><suffix>, where key is the serial or, failing that, the path.
+static bool get_device_file_path(const char* dir, ohmd_device_desc* desc, const char* suffix, char* path, size_t size)
+{
+	// hidraw paths get reused by other devices, prefer the serial
+	const char* key = desc->serial[0] ? desc->serial : desc->path;
+
+	int len = snprintf(path, size, "%s/rift-%d-", dir, desc->revision);
+	if(len < 0 || (size_t)len + strlen(suffix) >= size){
+		path[0] = 0;
+		return false;
+	}
+
+	for(; *key && (size_t)len + strlen(suffix) < size - 1; key++)
+		path[len++] = isalnum((unsigned char)*key) ? *key : '_';
+
+	strcpy(path + len, suffix);
+	return true;
+}
+
+static bool get_cache_path(ohmd_device_desc* desc, char* path, size_t size)
+{
+	const char* dir = getenv(CACHE_DIR_ENV);
+	if(!dir || !*dir)
+		return false;
+
+	return get_device_file_path(dir, desc, "", path, size);
+}
+
+// the device may be opened several times within a second, files already there are left alone
+#define MAX_CAPTURES_PER_SECOND 100
+
+static ohmd_capture* open_capture(ohmd_context* ctx, ohmd_device_desc* desc)
+{
+	const char* dir = getenv(CAPTURE_DIR_ENV);
+	if(!dir || !*dir)
+		return NULL;
+
+	// a new file for every time the device is opened
+	char suffix[48], path[OHMD_STR_SIZE * 2];
+	long now = (long)time(NULL);
+
+	for(int i = 0; i < MAX_CAPTURES_PER_SECOND; i++){
+		if(i == 0)
+			snprintf(suffix, sizeof(suffix), "-%ld.capture", now);
+		else
+			snprintf(suffix, sizeof(suffix), "-%ld-%d.capture", now, i);
+
+		if(!get_device_file_path(dir, desc, suffix, path, sizeof(path)))
+			return NULL;
+
+		// created exclusively, so a capture made meanwhile by another process is never overwritten
+		bool exists;
+		ohmd_capture* capture = ohmd_create_new_capture(ctx, path, desc->revision, &exists);
+		if(exists)
+			continue;
+
+		if(capture)
+			LOGI("capturing to %s", path);
+
+		return capture;
+	}
+
+	LOGW("too many captures of %s this second", desc->path);
+	return NULL;
+}
+
+static bool load_cache(const char* path, rift_config* config)
+{
+	FILE* f = fopen(path, "rb");
+	if(!f)
+		return false;
+
+	rift_cache_record record;
+	bool ok = fread(&record, sizeof(record), 1, f) == 1 &&
+		record.magic == CACHE_MAGIC && record.size == sizeof(rift_config);
+
+	fclose(f);
+
+	if(ok)
+		*config = record.config;
+
+	return ok;
+}
+
+static void save_cache(const char* path, const rift_config* config)
+{
+	rift_cache_record record;
+	memset(&record, 0, sizeof(record));
+	record.magic = CACHE_MAGIC;
+	record.size = sizeof(rift_config);
+	record.config = *config;
+
+	FILE* f = fopen(path, "wb");
+	if(!f){
+		LOGW("could not write config cache %s", path);
+		return;
+	}
+
+	if(fwrite(&record, sizeof(record), 1, f) != 1)
+		LOGW("could not write config cache %s", path);
+
+	fclose(f);
+}
+
+static unsigned int verify_config(void* arg)
+{
+	rift_priv* priv = (rift_priv*)arg;
+
+	read_config(priv, &priv->verified_config);
+
+	if(memcmp(&priv->verified_config, &priv->cached_config, sizeof(rift_config)) != 0)
+		save_cache(priv->cache_path, &priv->verified_config);
+
+	ohmd_memory_barrier();
+	priv->verify_done = true;
+
+	return 0;
+}
+
+static void finish_verify(rift_priv* priv)
 {
-	if(!decode_tracker_sensor_msg(&priv->sensor, buffer, size)){
-		LOGE("couldn't decode tracker sensor message");
+	ohmd_destroy_thread(priv->verify_thread);
+	priv->verify_thread = NULL;
+	priv->verify_done = false;
+
+	rift_config* config = &priv->verified_config;
+
+	if(memcmp(&config->range, &priv->cached_config.range, sizeof(pkt_sensor_range)) != 0 ||
+	   memcmp(&config->display_info, &priv->cached_config.display_info, sizeof(pkt_sensor_display_info)) != 0){
+		LOGW("cached config for %s was out of date", priv->cache_path);
+		apply_config(priv, config);
+		priv->base.pose_dirty = true;
+	}else{
+		priv->sensor_config = config->sensor_config;
+		priv->hw_coordinate_frame = config->hw_coordinate_frame;
 	}
+}
 
-	pkt_tracker_sensor* s = &priv->sensor;
+// Reads the device as soon as reports arrive, so they don't pile up in the
+// OS buffers while the update thread is busy, and queues them for fusion.
+static unsigned int reader_thread(void* arg)
+{
+	rift_priv* priv = (rift_priv*)arg;
+	unsigned char buffer[FEATURE_BUFFER_SIZE];
 
-	dump_packet_tracker_sensor(s);
+	while(!priv->reader_quit){
+		int size = hid_read_timeout(priv->handle, buffer, FEATURE_BUFFER_SIZE, READER_TIMEOUT_MS);
+		if(size < 0){
+			LOGE("error reading from device");
+			ohmd_sleep(READER_TIMEOUT_MS / 1000.0);
+			continue;
+		} else if(size == 0) {
+			continue;
+		}
 
-	// TODO handle missed samples etc.
+		double now = ohmd_get_tick();
 
-	float dt = s->num_samples > 3 ? (s->num_samples - 2) * TICK_LEN : TICK_LEN;
+		if(priv->capture)
+			ohmd_capture_write(priv->capture, OHMD_CAPTURE_INPUT_REPORT, now, buffer, size);
 
-	int32_t mag32[] = { s->mag[0], s->mag[1], s->mag[2] };
-	vec3f_from_rift_vec(mag32, &priv->raw_mag);
+		// currently the only message type the hardware supports (I think)
+		if(buffer[0] != RIFT_IRQ_SENSORS){
+			LOGE("unknown message type: %u", buffer[0]);
+			continue;
+		}
 
-	for(int i = 0; i < OHMD_MIN(s->num_samples, 3); i++){
-		vec3f_from_rift_vec(s->samples[i].accel, &priv->raw_accel);
-		vec3f_from_rift_vec(s->samples[i].gyro, &priv->raw_gyro);
+		// if fusion fell behind the report is dropped rather than stalling the reads
+		rift_report* report = ohmd_ring_begin_push(priv->reports);
+		if(!report)
+			continue;
 
-		ofusion_update(&priv->sensor_fusion, dt, &priv->raw_gyro, &priv->raw_accel, &priv->raw_mag);
+		if(!decode_tracker_sensor_msg(&report->sensor, buffer, size)){
+			LOGE("couldn't decode tracker sensor message");
+			continue;
+		}
 
-		// reset dt to tick_len for the last samples if there were more than one sample
-		dt = TICK_LEN;
+		report->time = now;
+		ohmd_ring_end_push(priv->reports);
+		ohmd_device_signal_data(&priv->base);
 	}
+
+	return 0;
 }
 
 static void update_device(ohmd_device* device)
@@ -116,6 +402,10 @@ static void update_device(ohmd_device* device)
 	rift_priv* priv = rift_priv_get(device);
 	unsigned char buffer[FEATURE_BUFFER_SIZE];
 
+	// Pick up the config read in the background by verify_config
+	if(priv->verify_done)
+		finish_verify(priv);
+
 	// Handle keep alive messages
 	double t = ohmd_get_tick();
 	if(t - priv->last_keep_alive >= (double)priv->sensor_config.keep_alive_interval / 1000.0 - .2){
@@ -128,23 +418,48 @@ static void update_device(ohmd_device* device)
 		priv->last_keep_alive = t;
 	}
 
-	// Read all the messages from the device.
-	while(true){
-		int size = hid_read(priv->handle, buffer, FEATURE_BUFFER_SIZE);
-		if(size < 0){
-			LOGE("error reading from device");
-			return;
-		} else if(size == 0) {
-			return; // No more messages, return.
-		}
+	// Fuse the reports queued by the reader thread.
+	rift_report* report;
+	while((report = ohmd_ring_peek(priv->reports)) != NULL){
+		rift_tracker_handle_msg(&priv->tracker, &priv->base, &report->sensor, report->time);
+		ohmd_ring_pop(priv->reports);
+	}
+}
 
-		// currently the only message type the hardware supports (I think)
-		if(buffer[0] == RIFT_IRQ_SENSORS){
-			handle_tracker_sensor_msg(priv, buffer, size);
-		}else{
-			LOGE("unknown message type: %u", buffer[0]);
-		}
+static bool wait_for_data(ohmd_device* device, double timeout)
+{
+	rift_priv* priv = rift_priv_get(device);
+
+	return ohmd_ring_wait(priv->reports, timeout);
+}
+
+static int geti(ohmd_device* device, ohmd_int_value type, int* out)
+{
+	rift_priv* priv = rift_priv_get(device);
+
+	switch(type){
+	case OHMD_SENSOR_QUEUE_DEPTH:
+		*out = ohmd_ring_get_depth(priv->reports);
+		break;
+
+	case OHMD_SENSOR_QUEUE_OVERRUNS:
+		*out = (int)ohmd_ring_get_overruns(priv->reports);
+		break;
+
+	case OHMD_DROPPED_SAMPLES:
+		*out = (int)priv->tracker.dropped_samples;
+		break;
+
+	case OHMD_LATE_SAMPLES:
+		*out = (int)priv->tracker.late_samples;
+		break;
+
+	default:
+		ohmd_set_error(priv->base.ctx, "invalid type given to geti (%d)", type);
+		return -1;
 	}
+
+	return 0;
 }
 
 static int getf(ohmd_device* device, ohmd_float_value type, float* out)
@@ -160,7 +475,7 @@ static int getf(ohmd_device* device, ohmd_float_value type, float* out)
 		}
 
 	case OHMD_ROTATION_QUAT: {
-			*(quatf*)out = priv->sensor_fusion.orient;
+			*(quatf*)out = priv->tracker.sensor_fusion.orient;
 			break;
 		}
 
@@ -181,7 +496,19 @@ static void close_device(ohmd_device* device)
 {
 	LOGD("closing device");
 	rift_priv* priv = rift_priv_get(device);
+
+	priv->reader_quit = true;
+	ohmd_destroy_thread(priv->reader_thread);
+
+	if(priv->verify_thread)
+		ohmd_destroy_thread(priv->verify_thread);
+
 	hid_close(priv->handle);
+	ohmd_destroy_mutex(priv->feature_mutex);
+	ohmd_destroy_ring(priv->reports);
+
+	if(priv->capture)
+		ohmd_destroy_capture(priv->capture);
 	free(priv);
 }
 
@@ -206,78 +533,79 @@ static ohmd_device* open_device(ohmd_driver* driver, ohmd_device_desc* desc)
 		goto cleanup;
 	}
 
-	unsigned char buf[FEATURE_BUFFER_SIZE];
-	
-	int size;
+	priv->feature_mutex = ohmd_create_mutex(driver->ctx);
+	if(!priv->feature_mutex)
+		goto cleanup;
 
-	// Read and decode the sensor range
-	size = get_feature_report(priv, RIFT_CMD_RANGE, buf);
-	decode_sensor_range(&priv->sensor_range, buf, size);
-	dump_packet_sensor_range(&priv->sensor_range);
+	// Capturing is optional, the device works without it
+	priv->capture = open_capture(driver->ctx, desc);
 
-	// Read and decode display information
-	size = get_feature_report(priv, RIFT_CMD_DISPLAY_INFO, buf);
-	decode_sensor_display_info(&priv->display_info, buf, size);
-	dump_packet_sensor_display_info(&priv->display_info);
+	priv->reports = ohmd_create_ring(driver->ctx, sizeof(rift_report), REPORT_RING_SIZE);
+	if(!priv->reports)
+		goto cleanup;
 
-	// Read and decode the sensor config
-	size = get_feature_report(priv, RIFT_CMD_SENSOR_CONFIG, buf);
-	decode_sensor_config(&priv->sensor_config, buf, size);
-	dump_packet_sensor_config(&priv->sensor_config);
+	// Set default device properties
+	ohmd_set_default_device_properties(&priv->base.properties);
 
-	// if the sensor has display info data, use HMD coordinate frame
-	priv->coordinate_frame = priv->display_info.distortion_type != RIFT_DT_NONE ? RIFT_CF_HMD : RIFT_CF_SENSOR;
+	// Open from the cache if possible and read the device in the background,
+	// otherwise read it now and cache the result for the next time.
+	bool cached = get_cache_path(desc, priv->cache_path, sizeof(priv->cache_path)) &&
+		load_cache(priv->cache_path, &priv->cached_config);
 
-	// enable calibration
-	SETFLAG(priv->sensor_config.flags, RIFT_SCF_USE_CALIBRATION, 1);
-	SETFLAG(priv->sensor_config.flags, RIFT_SCF_AUTO_CALIBRATION, 1);
+	if(cached){
+		apply_config(priv, &priv->cached_config);
+		priv->verify_thread = ohmd_create_thread(driver->ctx, verify_config, priv);
+	}
 
-	// apply sensor config
-	set_coordinate_frame(priv, priv->coordinate_frame);
+	if(!priv->verify_thread){
+		rift_config config;
+		read_config(priv, &config);
+		apply_config(priv, &config);
 
-	// set keep alive interval to n seconds
-	pkt_keep_alive keep_alive = { 0, KEEP_ALIVE_VALUE };
-	size = encode_keep_alive(buf, &keep_alive);
-	send_feature_report(priv, buf, size);
+		if(priv->cache_path[0])
+			save_cache(priv->cache_path, &config);
+	}
 
 	// Update the time of the last keep alive we have sent.
 	priv->last_keep_alive = ohmd_get_tick();
 
-	// update sensor settings with new keep alive value
-	// (which will have been ignored in favor of the default 1000 ms one)
-	size = get_feature_report(priv, RIFT_CMD_SENSOR_CONFIG, buf);
-	decode_sensor_config(&priv->sensor_config, buf, size);
-	dump_packet_sensor_config(&priv->sensor_config);
-
-	// Set default device properties
-	ohmd_set_default_device_properties(&priv->base.properties);
-
-	// Set device properties
-	priv->base.properties.hsize = priv->display_info.h_screen_size;
-	priv->base.properties.vsize = priv->display_info.v_screen_size;
-	priv->base.properties.hres = priv->display_info.h_resolution;
-	priv->base.properties.vres = priv->display_info.v_resolution;
-	priv->base.properties.lens_sep = priv->display_info.lens_separation;
-	priv->base.properties.lens_vpos = priv->display_info.v_center;
-	priv->base.properties.fov = DEG_TO_RAD(125.5144f); // TODO calculate.
-	priv->base.properties.ratio = ((float)priv->display_info.h_resolution / (float)priv->display_info.v_resolution) / 2.0f;
-
-	// calculate projection eye projection matrices from the device properties
-	ohmd_calc_default_proj_matrices(&priv->base.properties);
-
 	// set up device callbacks
 	priv->base.update = update_device;
 	priv->base.close = close_device;
 	priv->base.getf = getf;
+	priv->base.driver_float_values = 1 << OHMD_DISTORTION_K;
+	priv->base.geti = geti;
+	priv->base.driver_int_values = (1 << OHMD_SENSOR_QUEUE_DEPTH) | (1 << OHMD_SENSOR_QUEUE_OVERRUNS) |
+		(1 << OHMD_DROPPED_SAMPLES) | (1 << OHMD_LATE_SAMPLES);
+	priv->base.wait_for_data = wait_for_data;
 
 	// initialize sensor fusion
-	ofusion_init(&priv->sensor_fusion);
+	rift_tracker_init(&priv->tracker);
+
+	// Start reading sensor reports only now, reading the config can take long
+	// enough for the reports read meanwhile to overrun the queue
+	priv->reader_thread = ohmd_create_thread(driver->ctx, reader_thread, priv);
+	if(!priv->reader_thread){
+		ohmd_set_error(driver->ctx, "could not create reader thread");
+		goto cleanup;
+	}
 
 	return &priv->base;
 
 cleanup:
-	if(priv)
+	if(priv){
+		if(priv->verify_thread)
+			ohmd_destroy_thread(priv->verify_thread);
+		if(priv->handle)
+			hid_close(priv->handle);
+		if(priv->feature_mutex)
+			ohmd_destroy_mutex(priv->feature_mutex);
+		if(priv->reports)
+			ohmd_destroy_ring(priv->reports);
+		if(priv->capture)
+			ohmd_destroy_capture(priv->capture);
 		free(priv);
+	}
 
 	return NULL;
 }
@@ -295,31 +623,38 @@ static void get_device_list(ohmd_driver* driver, ohmd_device_list* list)
 		0x2021 /* DK2 alternative id */,
 	};
 
-	for(int i = 0; i < RIFT_ID_COUNT; i++){
-		struct hid_device_info* devs = hid_enumerate(OCULUS_VR_INC_ID, ids[i]);
-		struct hid_device_info* cur_dev = devs;
+	// walking the HID tree is the slow part, so do it once for every
+	// Oculus VR device and match the product ids here
+	struct hid_device_info* devs = hid_enumerate(OCULUS_VR_INC_ID, 0);
+
+	for(struct hid_device_info* cur_dev = devs; cur_dev; cur_dev = cur_dev->next){
+		int id = 0;
+		while(id < RIFT_ID_COUNT && ids[id] != cur_dev->product_id)
+			id++;
 
-		if(devs == NULL)
+		if(id == RIFT_ID_COUNT)
 			continue;
 
-		while (cur_dev) {
-			ohmd_device_desc* desc = &list->devices[list->num_devices++];
+		ohmd_device_desc* desc = ohmd_device_list_add(list);
+		if(!desc)
+			break;
 
-			strcpy(desc->driver, "OpenHMD Rift Driver");
-			strcpy(desc->vendor, "Oculus VR, Inc.");
-			strcpy(desc->product, "Rift (Devkit)");
-			
-			desc->revision = i;
+		strcpy(desc->driver, "OpenHMD Rift Driver");
+		strcpy(desc->vendor, "Oculus VR, Inc.");
+		strcpy(desc->product, "Rift (Devkit)");
 
-			strcpy(desc->path, cur_dev->path);
+		desc->revision = id;
 
-			desc->driver_ptr = driver;
+		strcpy(desc->path, cur_dev->path);
 
-			cur_dev = cur_dev->next;
-		}
+		// serials are plain ascii, anything else is left out of the cache key
+		for(int i = 0; cur_dev->serial_number && cur_dev->serial_number[i] && i < OHMD_STR_SIZE - 1; i++)
+			desc->serial[i] = cur_dev->serial_number[i] < 128 ? (char)cur_dev->serial_number[i] : '_';
 
-		hid_free_enumeration(devs);
+		desc->driver_ptr = driver;
 	}
+
+	hid_free_enumeration(devs);
 }
 
 static void destroy_driver(ohmd_driver* drv)
@@ -335,12 +670,20 @@ ohmd_driver* ohmd_create_oculus_rift_drv(ohmd_context* ctx)
 	if(drv == NULL)
 		return NULL;
 
+	// devices may be opened from several threads at once, and hid_init isn't thread safe
+	if(hid_init() != 0){
+		ohmd_set_error(ctx, "could not initialize hidapi");
+		free(drv);
+		return NULL;
+	}
+
 	drv->get_device_list = get_device_list;
 	drv->open_device = open_device;
 	drv->ctx = ctx;
 	drv->get_device_list = get_device_list;
 	drv->open_device = open_device;
 	drv->destroy = destroy_driver;
+	drv->hid_devices = true;
 
 	return drv;
 }
@@ -92,6 +92,21 @@ typedef struct {
 	uint16_t keep_alive_interval;
 } pkt_keep_alive;
 
+// sensor fusion state of a Rift, shared by the Rift and replay drivers
+typedef struct {
+	fusion sensor_fusion;
+	vec3f raw_mag, raw_accel, raw_gyro;
+
+	// the device timestamp of the last message and its number of samples,
+	// the next message should carry the timestamp after its samples
+	bool have_timestamp;
+	uint16_t last_timestamp;
+	uint8_t last_num_samples;
+
+	unsigned int dropped_samples; // see OHMD_DROPPED_SAMPLES
+	unsigned int late_samples; // see OHMD_LATE_SAMPLES
+} rift_tracker;
+
 
 bool decode_sensor_range(pkt_sensor_range* range, const unsigned char* buffer, int size);
 bool decode_sensor_display_info(pkt_sensor_display_info* info, const unsigned char* buffer, int size);
@@ -99,13 +114,19 @@ bool decode_sensor_config(pkt_sensor_config* config, const unsigned char* buffer
 bool decode_tracker_sensor_msg(pkt_tracker_sensor* msg, const unsigned char* buffer, int size);
 
 void vec3f_from_rift_vec(const int32_t* smp, vec3f* out_vec);
+void rift_vec_from_vec3f(const vec3f* vec, int32_t* out_smp);
 
 int encode_sensor_config(unsigned char* buffer, const pkt_sensor_config* config);
 int encode_keep_alive(unsigned char* buffer, const pkt_keep_alive* keep_alive);
+int encode_tracker_sensor_msg(unsigned char* buffer, const pkt_tracker_sensor* msg);
 
 void dump_packet_sensor_range(const pkt_sensor_range* range);
 void dump_packet_sensor_config(const pkt_sensor_config* config);
 void dump_packet_sensor_display_info(const pkt_sensor_display_info* info);
 void dump_packet_tracker_sensor(const pkt_tracker_sensor* sensor);
 
+void rift_tracker_init(rift_tracker* tracker);
+// fuses the samples of a message read at the given host time and adds them to the pose history of device
+void rift_tracker_handle_msg(rift_tracker* tracker, ohmd_device* device, const pkt_tracker_sensor* msg, double time);
+
 #endif
@@ -0,0 +1,295 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Replay Driver - Feeds Captured Rift Reports Through the Rift Decoding and Fusion */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "../drv_oculus_rift/rift.h"
+
+// capture file to replay, see capture.h, no device is listed when it's not set
+#define REPLAY_FILE_ENV "OPENHMD_REPLAY_FILE"
+// "realtime" (the default), "paced" or "fast", see replay_mode
+#define REPLAY_MODE_ENV "OPENHMD_REPLAY_MODE"
+
+typedef enum {
+	// reports are fused once as much time has passed since opening as had when they were captured
+	REPLAY_REALTIME,
+	// one report is fused per update, so the update rate sets the pace
+	REPLAY_PACED,
+	// every report is fused by the first update
+	REPLAY_FAST,
+} replay_mode;
+
+typedef struct {
+	ohmd_device base;
+
+	FILE* file;
+	replay_mode mode;
+
+	// the next record to replay, if there is one
+	ohmd_capture_record next;
+	bool has_next;
+
+	// sample times are shifted so the first report was read when the device was opened
+	double time_offset;
+
+	pkt_sensor_display_info display_info;
+	rift_tracker tracker;
+} replay_priv;
+
+static replay_priv* replay_priv_get(ohmd_device* device)
+{
+	return (replay_priv*)device;
+}
+
+static replay_mode get_replay_mode()
+{
+	const char* mode = getenv(REPLAY_MODE_ENV);
+
+	if(mode && strcmp(mode, "paced") == 0)
+		return REPLAY_PACED;
+	if(mode && strcmp(mode, "fast") == 0)
+		return REPLAY_FAST;
+
+	return REPLAY_REALTIME;
+}
+
+static void read_next(replay_priv* priv)
+{
+	priv->has_next = ohmd_capture_read_record(priv->file, &priv->next);
+}
+
+// handles the next record, returns true if it was a sensor report
+static bool replay_next(replay_priv* priv)
+{
+	ohmd_capture_record* record = &priv->next;
+	bool fused = false;
+
+	if(record->type == OHMD_CAPTURE_INPUT_REPORT && record->size > 0 && record->data[0] == RIFT_IRQ_SENSORS){
+		pkt_tracker_sensor msg;
+		if(decode_tracker_sensor_msg(&msg, record->data, record->size)){
+			rift_tracker_handle_msg(&priv->tracker, &priv->base, &msg, record->time + priv->time_offset);
+			fused = true;
+		}else{
+			LOGE("couldn't decode tracker sensor message");
+		}
+	}
+
+	read_next(priv);
+	return fused;
+}
+
+static void update_device(ohmd_device* device)
+{
+	replay_priv* priv = replay_priv_get(device);
+	double now = ohmd_get_tick();
+
+	while(priv->has_next){
+		if(priv->mode == REPLAY_REALTIME && priv->next.time + priv->time_offset > now)
+			break;
+
+		if(replay_next(priv) && priv->mode == REPLAY_PACED)
+			break;
+	}
+}
+
+static int getf(ohmd_device* device, ohmd_float_value type, float* out)
+{
+	replay_priv* priv = replay_priv_get(device);
+
+	switch(type){
+	case OHMD_DISTORTION_K:
+		for (int i = 0; i < 6; i++) {
+			out[i] = priv->display_info.distortion_k[i];
+		}
+		break;
+
+	case OHMD_ROTATION_QUAT:
+		*(quatf*)out = priv->tracker.sensor_fusion.orient;
+		break;
+
+	case OHMD_POSITION_VECTOR:
+		out[0] = out[1] = out[2] = 0;
+		break;
+
+	default:
+		ohmd_set_error(priv->base.ctx, "invalid type given to getf (%d)", type);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int geti(ohmd_device* device, ohmd_int_value type, int* out)
+{
+	replay_priv* priv = replay_priv_get(device);
+
+	switch(type){
+	case OHMD_DROPPED_SAMPLES:
+		*out = (int)priv->tracker.dropped_samples;
+		break;
+
+	case OHMD_LATE_SAMPLES:
+		*out = (int)priv->tracker.late_samples;
+		break;
+
+	default:
+		ohmd_set_error(priv->base.ctx, "invalid type given to geti (%d)", type);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void close_device(ohmd_device* device)
+{
+	LOGD("closing replay device");
+	replay_priv* priv = replay_priv_get(device);
+	fclose(priv->file);
+	free(priv);
+}
+
+static void set_properties(replay_priv* priv, bool have_display_info)
+{
+	ohmd_set_default_device_properties(&priv->base.properties);
+
+	if(have_display_info){
+		// as the Rift driver does
+		priv->base.properties.hsize = priv->display_info.h_screen_size;
+		priv->base.properties.vsize = priv->display_info.v_screen_size;
+		priv->base.properties.hres = priv->display_info.h_resolution;
+		priv->base.properties.vres = priv->display_info.v_resolution;
+		priv->base.properties.lens_sep = priv->display_info.lens_separation;
+		priv->base.properties.lens_vpos = priv->display_info.v_center;
+		priv->base.properties.ratio = ((float)priv->display_info.h_resolution / (float)priv->display_info.v_resolution) / 2.0f;
+	}else{
+		// the DK1 values
+		priv->base.properties.hsize = 0.149760f;
+		priv->base.properties.vsize = 0.093600f;
+		priv->base.properties.hres = 1280;
+		priv->base.properties.vres = 800;
+		priv->base.properties.lens_sep = 0.063500;
+		priv->base.properties.lens_vpos = 0.046800;
+		priv->base.properties.ratio = (1280.0f / 800.0f) / 2.0f;
+	}
+
+	priv->base.properties.fov = DEG_TO_RAD(125.5144f);
+
+	// calculate projection eye projection matrices from the device properties
+	ohmd_calc_default_proj_matrices(&priv->base.properties);
+}
+
+static ohmd_device* open_device(ohmd_driver* driver, ohmd_device_desc* desc)
+{
+	replay_priv* priv = ohmd_alloc(driver->ctx, sizeof(replay_priv));
+	if(!priv)
+		return NULL;
+
+	priv->file = fopen(desc->path, "rb");
+	if(!priv->file){
+		ohmd_set_error(driver->ctx, "could not open capture file %.200s", desc->path);
+		free(priv);
+		return NULL;
+	}
+
+	int revision;
+	if(!ohmd_capture_read_header(priv->file, &revision)){
+		ohmd_set_error(driver->ctx, "%.200s is not a capture file", desc->path);
+		fclose(priv->file);
+		free(priv);
+		return NULL;
+	}
+
+	priv->mode = get_replay_mode();
+
+	// The display info is usually read before the first input report, but when the
+	// Rift was opened from its config cache it's read in the background meanwhile,
+	// so look through the whole capture for it. Its first input report sets the time.
+	long start = ftell(priv->file);
+	bool have_display_info = false, have_input_report = false;
+	double first_time = 0;
+
+	for(read_next(priv); priv->has_next && !(have_display_info && have_input_report); read_next(priv)){
+		ohmd_capture_record* record = &priv->next;
+
+		if(record->type == OHMD_CAPTURE_FEATURE_REPORT && !have_display_info){
+			if(record->size > 0 && record->data[0] == RIFT_CMD_DISPLAY_INFO)
+				have_display_info = decode_sensor_display_info(&priv->display_info, record->data, record->size);
+		}else if(record->type == OHMD_CAPTURE_INPUT_REPORT && !have_input_report){
+			first_time = record->time;
+			have_input_report = true;
+		}
+	}
+
+	if(start < 0 || fseek(priv->file, start, SEEK_SET) != 0){
+		ohmd_set_error(driver->ctx, "could not rewind capture file %.200s", desc->path);
+		fclose(priv->file);
+		free(priv);
+		return NULL;
+	}
+
+	// feature records are skipped as they come up in the replay
+	read_next(priv);
+
+	if(have_input_report)
+		priv->time_offset = ohmd_get_tick() - first_time;
+
+	set_properties(priv, have_display_info);
+
+	// set up device callbacks
+	priv->base.update = update_device;
+	priv->base.close = close_device;
+	priv->base.getf = getf;
+	priv->base.driver_float_values = 1 << OHMD_DISTORTION_K;
+	priv->base.geti = geti;
+	priv->base.driver_int_values = (1 << OHMD_DROPPED_SAMPLES) | (1 << OHMD_LATE_SAMPLES);
+
+	rift_tracker_init(&priv->tracker);
+
+	return &priv->base;
+}
+
+static void get_device_list(ohmd_driver* driver, ohmd_device_list* list)
+{
+	const char* path = getenv(REPLAY_FILE_ENV);
+	if(!path || !*path)
+		return;
+
+	ohmd_device_desc* desc = ohmd_device_list_add(list);
+	if(!desc)
+		return;
+
+	strcpy(desc->driver, "OpenHMD Replay Driver");
+	strcpy(desc->vendor, "OpenHMD");
+	strcpy(desc->product, "Replayed Rift");
+
+	snprintf(desc->path, OHMD_STR_SIZE, "%s", path);
+
+	desc->driver_ptr = driver;
+}
+
+static void destroy_driver(ohmd_driver* drv)
+{
+	LOGD("shutting down replay driver");
+	free(drv);
+}
+
+ohmd_driver* ohmd_create_replay_drv(ohmd_context* ctx)
+{
+	ohmd_driver* drv = ohmd_alloc(ctx, sizeof(ohmd_driver));
+	if(!drv)
+		return NULL;
+
+	drv->get_device_list = get_device_list;
+	drv->open_device = open_device;
+	drv->destroy = destroy_driver;
+	drv->ctx = ctx;
+
+	return drv;
+}
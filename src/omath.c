@@ -128,11 +128,12 @@ void oquatf_slerp (float fT, const quatf* rkP, const quatf* rkQ, bool shortestPa
 	quatf rkT;
 
 	// Do we need to invert rotation?
+	// (-q is the same rotation as q, taking the other way around)
 	if (fCos < 0.0f && shortestPath)
 	{
 		fCos = -fCos;
-		rkT = *rkQ;
-		oquatf_inverse(&rkT);
+		for(int i = 0; i < 4; i++)
+			rkT.arr[i] = -rkQ->arr[i];
 	}
 	else
 	{
@@ -12,224 +12,1423 @@
 #include <string.h>
 #include <stdio.h>
 
-// Running automatic updates at 144 Hz
+// Running automatic updates at 1000 Hz when the devices can't be waited on
 #define AUTOMATIC_UPDATE_SLEEP (1.0 / 1000.0)
+// Longest time the update thread blocks on a device, so keep alive messages still go out
+#define AUTOMATIC_UPDATE_WAIT_TIMEOUT (100.0 / 1000.0)
+// How often the hotplug thread checks if it should quit
+#define HOTPLUG_WAIT_TIMEOUT (100.0 / 1000.0)
 
-ohmd_context* OHMD_APIENTRY ohmd_ctx_create(void)
+void ohmd_add_driver(ohmd_context* ctx, ohmd_driver* driver)
+{
+	if(!driver)
+		return;
+
+	if(!ohmd_grow_array((void**)&ctx->drivers, &ctx->num_allocated_drivers, ctx->num_drivers + 1, sizeof(ohmd_driver*))){
+		LOGE("could not allocate RAM for driver");
+		driver->destroy(driver);
+		return;
+	}
+
+	ctx->drivers[ctx->num_drivers++] = driver;
+}
+
+// creates the enabled drivers, once
+static void create_drivers(ohmd_context* ctx)
+{
+	if(ctx->drivers_created)
+		return;
+
+	ctx->drivers_created = true;
+
+#if DRIVER_OCULUS_RIFT
+	if(ctx->enabled_drivers & OHMD_DRV_OCULUS_RIFT)
+		ohmd_add_driver(ctx, ohmd_create_oculus_rift_drv(ctx));
+#endif
+
+#if DRIVER_EXTERNAL
+	if(ctx->enabled_drivers & OHMD_DRV_EXTERNAL)
+		ohmd_add_driver(ctx, ohmd_create_external_drv(ctx));
+#endif
+
+#if DRIVER_ANDROID
+	if(ctx->enabled_drivers & OHMD_DRV_ANDROID)
+		ohmd_add_driver(ctx, ohmd_create_android_drv(ctx));
+#endif
+
+#if DRIVER_REPLAY
+	if(ctx->enabled_drivers & OHMD_DRV_REPLAY)
+		ohmd_add_driver(ctx, ohmd_create_replay_drv(ctx));
+#endif
+
+	// add dummy driver last to make it the lowest priority
+	if(ctx->enabled_drivers & OHMD_DRV_DUMMY)
+		ohmd_add_driver(ctx, ohmd_create_dummy_drv(ctx));
+}
+
+static void ohmd_set_default_ctx_settings(ohmd_ctx_settings* settings)
+{
+	settings->drivers = OHMD_DRV_ALL;
+	settings->lazy_drivers = false;
+}
+
+ohmd_context* OHMD_APIENTRY ohmd_ctx_create_ex(const ohmd_ctx_settings* settings)
 {
+	ohmd_ctx_settings defaults;
+
+	if(!settings){
+		ohmd_set_default_ctx_settings(&defaults);
+		settings = &defaults;
+	}
+
 	ohmd_context* ctx = calloc(1, sizeof(ohmd_context));
 	if(!ctx){
 		LOGE("could not allocate RAM for context");
 		return NULL;
 	}
 
-#if DRIVER_OCULUS_RIFT
-	ctx->drivers[ctx->num_drivers++] = ohmd_create_oculus_rift_drv(ctx);
-#endif
+	ctx->enabled_drivers = settings->drivers;
+	ctx->update_request_quit = false;
+
+	// guards the active device list and the probe state, each device has a lock of its own for updates
+	ctx->update_mutex = ohmd_create_mutex(ctx);
+
+	// signalled when an asynchronous probe finishes
+	ctx->probe_cond = ohmd_create_cond(ctx);
+
+	// signalled when any device the shared update thread may wait on has data
+	ctx->data_cond = ohmd_create_cond(ctx);
+
+	// signalled when a device that's being closed is released by the threads using it
+	ctx->release_cond = ohmd_create_cond(ctx);
+
+	if(!ctx->update_mutex || !ctx->probe_cond || !ctx->data_cond || !ctx->release_cond){
+		LOGE("could not create context locks");
+
+		if(ctx->update_mutex)
+			ohmd_destroy_mutex(ctx->update_mutex);
+		if(ctx->probe_cond)
+			ohmd_destroy_cond(ctx->probe_cond);
+		if(ctx->data_cond)
+			ohmd_destroy_cond(ctx->data_cond);
+	ohmd_destroy_cond(ctx->release_cond);
+		if(ctx->release_cond)
+			ohmd_destroy_cond(ctx->release_cond);
+		free(ctx);
+
+		return NULL;
+	}
+
+	if(!settings->lazy_drivers)
+		create_drivers(ctx);
+
+	return ctx;
+}
+
+ohmd_context* OHMD_APIENTRY ohmd_ctx_create(void)
+{
+	return ohmd_ctx_create_ex(NULL);
+}
+
+ohmd_ctx_settings* OHMD_APIENTRY ohmd_ctx_settings_create(void)
+{
+	ohmd_ctx_settings* settings = calloc(1, sizeof(ohmd_ctx_settings));
+	if(!settings){
+		LOGE("could not allocate RAM for context settings");
+		return NULL;
+	}
+
+	ohmd_set_default_ctx_settings(settings);
+
+	return settings;
+}
+
+ohmd_status OHMD_APIENTRY ohmd_ctx_settings_seti(ohmd_ctx_settings* settings, ohmd_int_ctx_settings key, const int* val)
+{
+	switch(key){
+	case OHMD_ICS_DRIVERS:
+		settings->drivers = val[0];
+		return OHMD_S_OK;
+
+	case OHMD_ICS_LAZY_DRIVERS:
+		settings->lazy_drivers = val[0] == 0 ? false : true;
+		return OHMD_S_OK;
+
+	default:
+		return OHMD_S_INVALID_PARAMETER;
+	}
+}
+
+void OHMD_APIENTRY ohmd_ctx_settings_destroy(ohmd_ctx_settings* settings)
+{
+	free(settings);
+}
+
+static void close_device_unp(ohmd_device* device)
+{
+	ohmd_mutex* mutex = device->update_mutex;
+
+	if(device->update_thread){
+		device->update_request_quit = 1;
+		ohmd_signal_cond(device->sample_cond);
+		ohmd_destroy_thread(device->update_thread);
+	}
+
+	ohmd_cond* sample_cond = device->sample_cond;
+
+	device->close(device);
+	ohmd_destroy_cond(sample_cond);
+	ohmd_destroy_mutex(mutex);
+}
+
+void OHMD_APIENTRY ohmd_ctx_destroy(ohmd_context* ctx)
+{
+	ohmd_ctx_stop_hotplug(ctx);
+
+	// a running probe still uses the drivers
+	if(ctx->probe_thread)
+		ohmd_destroy_thread(ctx->probe_thread);
+
+	ctx->update_request_quit = true;
+
+	// stop the update thread before the devices it updates go away, waking it if it waits for data
+	if(ctx->update_thread){
+		ctx->data_seq++;
+		ohmd_signal_cond(ctx->data_cond);
+		ohmd_destroy_thread(ctx->update_thread);
+	}
+
+	for(int i = 0; i < ctx->num_active_devices; i++){
+		close_device_unp(ctx->active_devices[i]);
+	}
+
+	for(int i = 0; i < ctx->num_drivers; i++){
+		ctx->drivers[i]->destroy(ctx->drivers[i]);
+	}
+
+	ohmd_destroy_mutex(ctx->update_mutex);
+	ohmd_destroy_cond(ctx->probe_cond);
+	ohmd_destroy_cond(ctx->data_cond);
+
+	free(ctx->drivers);
+	free(ctx->active_devices);
+	free(ctx->list.devices);
+
+	for(int i = 0; i < ctx->num_retired_lists; i++)
+		free(ctx->retired_lists[i]);
+	free(ctx->retired_lists);
+
+	free(ctx);
+}
+
+// fetch the latest pose from the driver and publish it to readers, call with the device update_mutex held
+static void update_pose(ohmd_device* dev)
+{
+	vec3f position;
+	quatf rotation;
+
+	dev->getf(dev, OHMD_POSITION_VECTOR, (float*)&position);
+	dev->getf(dev, OHMD_ROTATION_QUAT, (float*)&rotation);
+
+	// the published matrices only need rebuilding when something they depend on changed
+	if(!dev->pose_dirty && dev->pose.sample == dev->num_samples &&
+	   memcmp(&position, &dev->position, sizeof(vec3f)) == 0 && memcmp(&rotation, &dev->rotation, sizeof(quatf)) == 0)
+		return;
+
+	dev->position = position;
+	dev->rotation = rotation;
+	dev->pose_dirty = false;
+
+	ohmd_device_publish_pose(dev);
+}
+
+#define SAMPLE_AT(_dev, _n) (&(_dev)->samples[(_n) & (OHMD_POSE_HISTORY_SIZE - 1)])
+
+static void dispatch_pose_callback(ohmd_device* dev);
+
+// true if there are samples the pose callback has not been given yet, call with the device update_mutex held
+static bool has_pose_callback_samples(ohmd_device* dev)
+{
+	return dev->pose_callback && dev->pose_callback_sample != dev->num_samples;
+}
+
+// Copies the active devices matching filter to *devs, growing it as needed, and returns how many there are.
+// The devices stay open until release_devices, so they can be used without the context lock.
+static int snapshot_devices(ohmd_context* ctx, ohmd_device*** devs, int* num_allocated, bool (*filter)(ohmd_device* dev))
+{
+	int num_devs = 0;
+
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	if(ohmd_grow_array((void**)devs, num_allocated, ctx->num_active_devices, sizeof(ohmd_device*))){
+		for(int i = 0; i < ctx->num_active_devices; i++){
+			ohmd_device* dev = ctx->active_devices[i];
+			if(!filter || filter(dev)){
+				dev->num_unlocked_users++;
+				(*devs)[num_devs++] = dev;
+			}
+		}
+	}else{
+		LOGE("could not allocate RAM for device snapshot");
+	}
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	return num_devs;
+}
+
+// lets ohmd_close_device close the devices of a snapshot again
+static void release_devices(ohmd_context* ctx, ohmd_device** devs, int num_devs)
+{
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	for(int i = 0; i < num_devs; i++)
+		devs[i]->num_unlocked_users--;
+
+	// only woken when a close waits, this runs for every round of the update thread
+	bool wake = ctx->num_release_waiters > 0;
+	if(wake)
+		ctx->release_seq++;
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	if(wake)
+		ohmd_signal_cond(ctx->release_cond);
+}
+
+void OHMD_APIENTRY ohmd_ctx_update(ohmd_context* ctx)
+{
+	ohmd_device** devs = NULL;
+	int num_allocated = 0;
+	int num_devs = snapshot_devices(ctx, &devs, &num_allocated, NULL);
+
+	// each device is only locked while it's updated, so a slow one doesn't hold up the others
+	for(int i = 0; i < num_devs; i++){
+		ohmd_device* dev = devs[i];
+		bool manual = !dev->settings.automatic_update;
+
+		ohmd_lock_mutex(dev->update_mutex);
+
+		if(manual && dev->update)
+			dev->update(dev);
+
+		update_pose(dev);
+
+		// automatic devices get their callbacks from their update thread
+		bool dispatch = manual && has_pose_callback_samples(dev);
+
+		ohmd_unlock_mutex(dev->update_mutex);
+
+		if(dispatch)
+			dispatch_pose_callback(dev);
+	}
+
+	release_devices(ctx, devs, num_devs);
+	free(devs);
+}
+
+const char* OHMD_APIENTRY ohmd_ctx_get_error(ohmd_context* ctx)
+{
+	return ctx->error_msg;
+}
+
+typedef struct {
+	ohmd_hotplug_event event;
+	int id;
+} list_change;
+
+static void add_list_change(list_change** changes, int* num_changes, int* num_allocated, ohmd_hotplug_event event, int id)
+{
+	if(!ohmd_grow_array((void**)changes, num_allocated, *num_changes + 1, sizeof(list_change))){
+		LOGE("could not allocate RAM for device list change");
+		return;
+	}
+
+	(*changes)[*num_changes].event = event;
+	(*changes)[*num_changes].id = id;
+	(*num_changes)++;
+}
+
+typedef struct {
+	ohmd_driver* driver;
+	ohmd_device_list list;
+	ohmd_thread* thread;
+} probe_worker;
+
+static unsigned int probe_worker_thread(void* arg)
+{
+	probe_worker* worker = (probe_worker*)arg;
+	worker->driver->get_device_list(worker->driver, &worker->list);
+	return 0;
+}
+
+// Enumerate the devices of all drivers in parallel, or of the HID drivers only, the results are
+// added to found in driver order
+static void enumerate_devices(ohmd_context* ctx, ohmd_device_list* found, bool hid_only)
+{
+	probe_worker* workers = calloc(ctx->num_drivers, sizeof(probe_worker));
+	if(!workers){
+		for(int i = 0; i < ctx->num_drivers; i++){
+			if(!hid_only || ctx->drivers[i]->hid_devices)
+				ctx->drivers[i]->get_device_list(ctx->drivers[i], found);
+		}
+		return;
+	}
+
+	int last = -1;
+	for(int i = 0; i < ctx->num_drivers; i++){
+		if(hid_only && !ctx->drivers[i]->hid_devices)
+			continue;
+
+		workers[i].driver = ctx->drivers[i];
+
+		// the last driver is enumerated on this thread, as is any driver a thread can't be started for
+		if(last >= 0){
+			workers[last].thread = ohmd_create_thread(ctx, probe_worker_thread, &workers[last]);
+			if(!workers[last].thread)
+				probe_worker_thread(&workers[last]);
+		}
+
+		last = i;
+	}
+
+	if(last >= 0)
+		probe_worker_thread(&workers[last]);
+
+	for(int i = 0; i < ctx->num_drivers; i++){
+		if(workers[i].thread)
+			ohmd_destroy_thread(workers[i].thread);
+
+		for(int j = 0; j < workers[i].list.num_devices; j++){
+			ohmd_device_desc* desc = ohmd_device_list_add(found);
+			if(desc)
+				*desc = workers[i].list.devices[j];
+		}
+
+		free(workers[i].list.devices);
+	}
+
+	free(workers);
+}
+
+static bool is_listed(ohmd_device_list* list, int id)
+{
+	for(int i = 0; i < list->num_devices; i++){
+		if(list->devices[i].id == id)
+			return true;
+	}
+
+	return false;
+}
+
+static bool lists_equal(ohmd_device_list* a, ohmd_device_list* b)
+{
+	return a->num_devices == b->num_devices &&
+	       memcmp(a->devices, b->devices, a->num_devices * sizeof(ohmd_device_desc)) == 0;
+}
+
+static void add_list_entry(ohmd_device_list* list, const ohmd_device_desc* desc)
+{
+	ohmd_device_desc* entry = ohmd_device_list_add(list);
+	if(entry)
+		*entry = *desc;
+	else
+		LOGE("could not allocate RAM for device list entry");
+}
+
+// Makes list the device list, call with the context update_mutex held. Strings handed out by
+// ohmd_list_gets point into the old list, so it's kept until the context is destroyed, unless
+// nothing changed and list can go instead.
+static void replace_device_list(ohmd_context* ctx, ohmd_device_list* list)
+{
+	if(lists_equal(&ctx->list, list)){
+		free(list->devices);
+		return;
+	}
+
+	if(ctx->list.devices){
+		if(ohmd_grow_array((void**)&ctx->retired_lists, &ctx->num_allocated_retired_lists,
+		                   ctx->num_retired_lists + 1, sizeof(ohmd_device_desc*)))
+			ctx->retired_lists[ctx->num_retired_lists++] = ctx->list.devices;
+		else
+			LOGE("could not allocate RAM for replaced device list, leaking it");
+	}
+
+	ctx->list = *list;
+}
+
+// selects the entries of the device list an update replaces, the others are kept as they are
+typedef bool (*list_filter)(const ohmd_device_desc* desc, const char* name);
+
+static bool is_any_entry(const ohmd_device_desc* desc, const char* name)
+{
+	return true;
+}
+
+static bool is_hid_entry(const ohmd_device_desc* desc, const char* name)
+{
+	return desc->driver_ptr->hid_devices;
+}
+
+// true for entries of the device node called name, hidapi paths are either the node or its full path
+static bool is_node_entry(const ohmd_device_desc* desc, const char* name)
+{
+	size_t path_len = strlen(desc->path), name_len = strlen(name);
+
+	return desc->driver_ptr->hid_devices && path_len >= name_len &&
+	       strcmp(desc->path + path_len - name_len, name) == 0 &&
+	       (path_len == name_len || desc->path[path_len - name_len - 1] == '/');
+}
+
+// Replaces the entries of the device list selected by replaced with the ones in found, keeping
+// driver order. Devices that were listed before keep their id. Changes are reported to the hotplug
+// callback, if there is one, and their number is returned in num_changes, if it isn't NULL.
+static int update_device_list(ohmd_context* ctx, ohmd_device_list* found, list_filter replaced, const char* name, int* num_changes)
+{
+	ohmd_device_list merged = { 0 };
+	list_change* changes = NULL;
+	int num_list_changes = 0, num_allocated_changes = 0;
+
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	ohmd_device_list* list = &ctx->list;
+
+	for(int d = 0; d < ctx->num_drivers; d++){
+		ohmd_driver* driver = ctx->drivers[d];
+
+		for(int j = 0; j < list->num_devices; j++){
+			ohmd_device_desc* old = &list->devices[j];
+			if(old->driver_ptr == driver && !replaced(old, name))
+				add_list_entry(&merged, old);
+		}
+
+		for(int i = 0; i < found->num_devices; i++){
+			ohmd_device_desc* desc = &found->devices[i];
+			if(desc->driver_ptr != driver)
+				continue;
+
+			for(int j = 0; j < list->num_devices; j++){
+				ohmd_device_desc* old = &list->devices[j];
+
+				if(old->driver_ptr == driver && replaced(old, name) &&
+				   strcmp(old->path, desc->path) == 0 && !is_listed(&merged, old->id)){
+					desc->id = old->id;
+					break;
+				}
+			}
+
+			if(desc->id == 0){
+				desc->id = ++ctx->last_device_id;
+				add_list_change(&changes, &num_list_changes, &num_allocated_changes, OHMD_HOTPLUG_ADDED, desc->id);
+			}
+
+			add_list_entry(&merged, desc);
+		}
+	}
+
+	for(int j = 0; j < list->num_devices; j++){
+		if(!is_listed(&merged, list->devices[j].id))
+			add_list_change(&changes, &num_list_changes, &num_allocated_changes, OHMD_HOTPLUG_REMOVED, list->devices[j].id);
+	}
+
+	replace_device_list(ctx, &merged);
+
+	int num_devices = list->num_devices;
+	ohmd_hotplug_callback callback = ctx->hotplug_callback;
+	void* user_data = ctx->hotplug_data;
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	if(callback){
+		for(int i = 0; i < num_list_changes; i++)
+			callback(ctx, changes[i].event, changes[i].id, user_data);
+	}
+
+	free(changes);
+
+	if(num_changes)
+		*num_changes = num_list_changes;
+
+	return num_devices;
+}
+
+// enumerate the devices of every driver, or of the HID drivers only, and update the device list with them
+static int probe_devices(ohmd_context* ctx, bool hid_only)
+{
+	ohmd_device_list found = { 0 };
+
+	// enumeration can be slow, so the context isn't locked for it
+	enumerate_devices(ctx, &found, hid_only);
+
+	int num_devices = update_device_list(ctx, &found, hid_only ? is_hid_entry : is_any_entry, NULL, NULL);
+	free(found.devices);
+
+	return num_devices;
+}
+
+// drops the entries of a removed device node from the device list, returns false if there were none
+static bool remove_node_devices(ohmd_context* ctx, const char* name)
+{
+	ohmd_device_list none = { 0 };
+	int num_changes;
+
+	update_device_list(ctx, &none, is_node_entry, name, &num_changes);
+
+	return num_changes > 0;
+}
+
+static unsigned int ohmd_probe_thread(void* arg)
+{
+	ohmd_context* ctx = (ohmd_context*)arg;
+
+	ohmd_lock_mutex(ctx->update_mutex);
+	ohmd_probe_callback callback = ctx->probe_callback;
+	void* user_data = ctx->probe_data;
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	ctx->probe_result = probe_devices(ctx, false);
+
+	// waiters are released before the callback, so it may wait on the probe as well
+	ohmd_memory_barrier();
+	ctx->probe_running = 0;
+	ohmd_signal_cond(ctx->probe_cond);
+
+	if(callback)
+		callback(ctx, ctx->probe_result, user_data);
+
+	return 0;
+}
+
+int OHMD_APIENTRY ohmd_ctx_probe_async(ohmd_context* ctx, ohmd_probe_callback callback, void* user_data)
+{
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	// the probe thread can't wait for itself to finish
+	if(ctx->probe_thread && ohmd_is_current_thread(ctx->probe_thread)){
+		ohmd_unlock_mutex(ctx->update_mutex);
+		ohmd_set_error(ctx, "can't start a probe from the probe callback");
+		return OHMD_S_INVALID_PARAMETER;
+	}
+
+	// one probe at a time, another caller may start one while this one waits
+	while(ctx->probe_thread){
+		ohmd_thread* running = ctx->probe_thread;
+		ctx->probe_thread = NULL;
+
+		ohmd_unlock_mutex(ctx->update_mutex);
+		ohmd_destroy_thread(running);
+		ohmd_lock_mutex(ctx->update_mutex);
+	}
+
+	create_drivers(ctx);
+
+	ctx->probe_callback = callback;
+	ctx->probe_data = user_data;
+	ctx->probe_running = 1;
+
+	// the thread reads the callback once the context is unlocked
+	ctx->probe_thread = ohmd_create_thread(ctx, ohmd_probe_thread, ctx);
+	bool started = ctx->probe_thread != NULL;
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	// still gets the job done, just not in the background
+	if(!started)
+		ohmd_probe_thread(ctx);
+
+	return OHMD_S_OK;
+}
+
+int OHMD_APIENTRY ohmd_ctx_wait_probe(ohmd_context* ctx, double timeout)
+{
+	if(!ohmd_wait_cond(ctx->probe_cond, &ctx->probe_running, 1, timeout))
+		return OHMD_S_TIMEOUT;
+
+	return ctx->probe_result;
+}
+
+int OHMD_APIENTRY ohmd_ctx_probe(ohmd_context* ctx)
+{
+	int ret = ohmd_ctx_probe_async(ctx, NULL, NULL);
+	if(ret != OHMD_S_OK)
+		return ret;
+
+	while((ret = ohmd_ctx_wait_probe(ctx, 1.0)) == OHMD_S_TIMEOUT)
+		;
+
+	return ret;
+}
+
+static unsigned int ohmd_hotplug_thread(void* arg)
+{
+	ohmd_context* ctx = (ohmd_context*)arg;
+	ohmd_dir_change change;
+
+	while(!ctx->hotplug_request_quit){
+		if(!ohmd_wait_dir_watch(ctx->hotplug_watch, HOTPLUG_WAIT_TIMEOUT, &change))
+			continue;
+
+		// Removed nodes take their entries with them, while added ones can only be told apart by
+		// enumerating the HID drivers. That's done once for a whole burst of changes, and for removed
+		// nodes that no entry could be found for.
+		bool enumerate = false;
+		do {
+			if(!change.removed || !remove_node_devices(ctx, change.name))
+				enumerate = true;
+		} while(ohmd_wait_dir_watch(ctx->hotplug_watch, 0, &change));
+
+		if(enumerate)
+			probe_devices(ctx, true);
+	}
+
+	return 0;
+}
+
+int ohmd_start_hotplug(ohmd_context* ctx, const char* path, const char* prefix, ohmd_hotplug_callback callback, void* user_data)
+{
+	ohmd_ctx_stop_hotplug(ctx);
+
+	create_drivers(ctx);
+
+	ctx->hotplug_watch = ohmd_create_dir_watch(ctx, path, prefix);
+	if(!ctx->hotplug_watch)
+		return OHMD_S_UNSUPPORTED;
+
+	ohmd_lock_mutex(ctx->update_mutex);
+	ctx->hotplug_callback = callback;
+	ctx->hotplug_data = user_data;
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	// anything plugged in from here on is seen by the watch, so nothing falls between this probe and the thread
+	probe_devices(ctx, false);
+
+	ctx->hotplug_request_quit = false;
+	ctx->hotplug_thread = ohmd_create_thread(ctx, ohmd_hotplug_thread, ctx);
+	if(!ctx->hotplug_thread){
+		ohmd_ctx_stop_hotplug(ctx);
+		ohmd_set_error(ctx, "could not create hotplug thread");
+		return OHMD_S_UNKNOWN_ERROR;
+	}
+
+	return OHMD_S_OK;
+}
+
+int OHMD_APIENTRY ohmd_ctx_start_hotplug(ohmd_context* ctx, ohmd_hotplug_callback callback, void* user_data)
+{
+	// every HID device gets a hidraw node, Rifts included
+	return ohmd_start_hotplug(ctx, "/dev", "hidraw", callback, user_data);
+}
+
+void OHMD_APIENTRY ohmd_ctx_stop_hotplug(ohmd_context* ctx)
+{
+	if(ctx->hotplug_thread){
+		ctx->hotplug_request_quit = true;
+		ohmd_destroy_thread(ctx->hotplug_thread);
+		ctx->hotplug_thread = NULL;
+	}
+
+	if(ctx->hotplug_watch){
+		ohmd_destroy_dir_watch(ctx->hotplug_watch);
+		ctx->hotplug_watch = NULL;
+	}
+
+	ohmd_lock_mutex(ctx->update_mutex);
+	ctx->hotplug_callback = NULL;
+	ctx->hotplug_data = NULL;
+	ohmd_unlock_mutex(ctx->update_mutex);
+}
+
+const char* OHMD_APIENTRY ohmd_list_gets(ohmd_context* ctx, int index, ohmd_string_value type)
+{
+	const char* str = NULL;
+
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	if(index >= 0 && index < ctx->list.num_devices){
+		ohmd_device_desc* desc = &ctx->list.devices[index];
+
+		switch(type){
+		case OHMD_VENDOR:
+			str = desc->vendor;
+			break;
+		case OHMD_PRODUCT:
+			str = desc->product;
+			break;
+		case OHMD_PATH:
+			str = desc->path;
+			break;
+		}
+	}
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	return str;
+}
+
+int OHMD_APIENTRY ohmd_list_get_id(ohmd_context* ctx, int index)
+{
+	int id = -1;
+
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	if(index >= 0 && index < ctx->list.num_devices)
+		id = ctx->list.devices[index].id;
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	return id;
+}
+
+int OHMD_APIENTRY ohmd_list_find_id(ohmd_context* ctx, int id)
+{
+	int index = -1;
+
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	for(int i = 0; i < ctx->list.num_devices; i++){
+		if(ctx->list.devices[i].id == id){
+			index = i;
+			break;
+		}
+	}
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	return index;
+}
+
+static bool is_shared_update_device(ohmd_device* dev)
+{
+	return dev->settings.automatic_update && dev->settings.update_mode == OHMD_UPDATE_MODE_SHARED && dev->update;
+}
+
+static unsigned int ohmd_update_thread(void* arg)
+{
+	ohmd_context* ctx = (ohmd_context*)arg;
+
+	// kept from round to round, it only grows
+	ohmd_device** devs = NULL;
+	int num_allocated = 0;
+
+	while(!ctx->update_request_quit)
+	{
+		// data arriving from here on cuts the wait below short
+		unsigned int data_seq = ctx->data_seq;
+
+		int num_devs = snapshot_devices(ctx, &devs, &num_allocated, is_shared_update_device);
+		bool waitable = true;
+
+		// each device is only locked while it's updated, so a slow one doesn't hold up the others
+		for(int i = 0; i < num_devs; i++){
+			ohmd_device* dev = devs[i];
+
+			ohmd_lock_mutex(dev->update_mutex);
+			dev->update(dev);
+			update_pose(dev);
+			bool dispatch = has_pose_callback_samples(dev);
+			ohmd_unlock_mutex(dev->update_mutex);
+
+			if(dispatch)
+				dispatch_pose_callback(dev);
+
+			if(!dev->wait_for_data)
+				waitable = false;
+		}
+
+		release_devices(ctx, devs, num_devs);
+
+		// Devices that can be waited on signal the context when they have data, so the thread
+		// blocks until any of them has some. If there is one that can't, they are all polled.
+		if(waitable)
+			ohmd_wait_cond(ctx->data_cond, &ctx->data_seq, data_seq, AUTOMATIC_UPDATE_WAIT_TIMEOUT);
+		else
+			ohmd_sleep(AUTOMATIC_UPDATE_SLEEP);
+	}
+
+	free(devs);
+
+	return 0;
+}
+
+// call with the context update_mutex held
+static void ohmd_set_up_update_thread(ohmd_context* ctx)
+{
+	if(!ctx->update_thread){
+		ctx->update_thread = ohmd_create_thread(ctx, ohmd_update_thread, ctx);
+	}
+}
+
+static unsigned int ohmd_device_update_thread(void* arg)
+{
+	ohmd_device* dev = (ohmd_device*)arg;
+	double interval = dev->settings.update_rate > 0 ? 1.0 / dev->settings.update_rate : 0;
+	double next_update = ohmd_get_tick();
+
+	while(!dev->update_request_quit)
+	{
+		ohmd_lock_mutex(dev->update_mutex);
+		dev->update(dev);
+		update_pose(dev);
+		bool dispatch = has_pose_callback_samples(dev);
+		ohmd_unlock_mutex(dev->update_mutex);
+
+		if(dispatch)
+			dispatch_pose_callback(dev);
+
+		if(interval > 0){
+			// fixed rate, skip the periods we fell behind on,
+			// closing the device cuts the wait short
+			double now = ohmd_get_tick();
+			next_update += interval;
+			if(next_update > now)
+				ohmd_wait_cond(dev->sample_cond, &dev->update_request_quit, 0, next_update - now);
+			else
+				next_update = now;
+		}else if(dev->wait_for_data){
+			dev->wait_for_data(dev, AUTOMATIC_UPDATE_WAIT_TIMEOUT);
+		}else{
+			ohmd_sleep(AUTOMATIC_UPDATE_SLEEP);
+		}
+	}
+
+	return 0;
+}
+
+static bool ohmd_set_up_device_update_thread(ohmd_device* device)
+{
+	device->update_thread = ohmd_create_thread(device->ctx, ohmd_device_update_thread, device);
+	if(!device->update_thread)
+		return false;
+
+	if(device->settings.update_cpu >= 0 && !ohmd_set_thread_affinity(device->update_thread, device->settings.update_cpu))
+		LOGW("could not pin update thread to cpu %d", device->settings.update_cpu);
+
+	return true;
+}
+
+static void ohmd_set_default_device_settings(ohmd_device_settings* settings)
+{
+	settings->automatic_update = true;
+	settings->update_mode = OHMD_UPDATE_MODE_SHARED;
+	settings->update_rate = 0;
+	settings->update_cpu = -1;
+}
+
+#define VALUE_BIT(_v) (1 << (_v))
+
+// getf values answered from the pose and device properties, whatever the driver
+#define CORE_FLOAT_VALUES ( \
+	VALUE_BIT(OHMD_ROTATION_QUAT) | VALUE_BIT(OHMD_POSITION_VECTOR) | \
+	VALUE_BIT(OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX) | VALUE_BIT(OHMD_RIGHT_EYE_GL_MODELVIEW_MATRIX) | \
+	VALUE_BIT(OHMD_LEFT_EYE_GL_PROJECTION_MATRIX) | VALUE_BIT(OHMD_RIGHT_EYE_GL_PROJECTION_MATRIX) | \
+	VALUE_BIT(OHMD_SCREEN_HORIZONTAL_SIZE) | VALUE_BIT(OHMD_SCREEN_VERTICAL_SIZE) | \
+	VALUE_BIT(OHMD_LENS_HORIZONTAL_SEPARATION) | VALUE_BIT(OHMD_LENS_VERTICAL_POSITION) | \
+	VALUE_BIT(OHMD_LEFT_EYE_FOV) | VALUE_BIT(OHMD_LEFT_EYE_ASPECT_RATIO) | \
+	VALUE_BIT(OHMD_RIGHT_EYE_FOV) | VALUE_BIT(OHMD_RIGHT_EYE_ASPECT_RATIO) | \
+	VALUE_BIT(OHMD_EYE_IPD) | VALUE_BIT(OHMD_PROJECTION_ZFAR) | VALUE_BIT(OHMD_PROJECTION_ZNEAR))
+
+#define CORE_INT_VALUES ( \
+	VALUE_BIT(OHMD_SCREEN_HORIZONTAL_RESOLUTION) | VALUE_BIT(OHMD_SCREEN_VERTICAL_RESOLUTION) | \
+	VALUE_BIT(OHMD_SUPPORTED_FLOAT_VALUES) | VALUE_BIT(OHMD_SUPPORTED_INT_VALUES) | \
+	VALUE_BIT(OHMD_SAMPLE_NUMBER) | VALUE_BIT(OHMD_POSE_GENERATION))
+
+// copies a device list entry, so it can be used without the context lock held
+static bool get_list_entry(ohmd_context* ctx, int index, ohmd_device_desc* out)
+{
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	bool found = index >= 0 && index < ctx->list.num_devices;
+	if(found)
+		*out = ctx->list.devices[index];
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	if(!found)
+		ohmd_set_error(ctx, "no device with index: %d", index);
+
+	return found;
+}
+
+// Opens and sets up a device that isn't active yet. Drivers do blocking I/O when opening
+// devices, so this is called without the context lock, possibly for several devices at once.
+static ohmd_device* open_device_unp(ohmd_context* ctx, ohmd_device_desc* desc, ohmd_device_settings* settings)
+{
+	ohmd_driver* driver = (ohmd_driver*)desc->driver_ptr;
+	ohmd_device* device = driver->open_device(driver, desc);
+
+	if (device == NULL)
+		return NULL;
+
+	device->update_mutex = ohmd_create_mutex(ctx);
+	if(device->update_mutex == NULL){
+		device->close(device);
+		return NULL;
+	}
+
+	device->sample_cond = ohmd_create_cond(ctx);
+	if(device->sample_cond == NULL){
+		ohmd_destroy_mutex(device->update_mutex);
+		device->close(device);
+		return NULL;
+	}
 
-#if DRIVER_EXTERNAL
-	ctx->drivers[ctx->num_drivers++] = ohmd_create_external_drv(ctx);
-#endif
+	device->rotation_correction.w = 1;
+	device->pose_dirty = true;
 
-#if DRIVER_ANDROID
-	ctx->drivers[ctx->num_drivers++] = ohmd_create_android_drv(ctx);
-#endif
-	// add dummy driver last to make it the lowest priority
-	ctx->drivers[ctx->num_drivers++] = ohmd_create_dummy_drv(ctx);
+	device->supported_float_values = CORE_FLOAT_VALUES | device->driver_float_values;
+	device->supported_int_values = CORE_INT_VALUES | device->driver_int_values;
 
-	ctx->update_request_quit = false;
+	device->settings = *settings;
 
-	return ctx;
+	device->ctx = ctx;
+	update_pose(device);
+
+	if(device->settings.automatic_update && device->settings.update_mode == OHMD_UPDATE_MODE_DEDICATED && device->update){
+		if(!ohmd_set_up_device_update_thread(device)){
+			close_device_unp(device);
+			ohmd_set_error(ctx, "could not create update thread");
+			return NULL;
+		}
+	}
+
+	return device;
 }
 
-void OHMD_APIENTRY ohmd_ctx_destroy(ohmd_context* ctx)
+// adds an opened device to the active devices, the device is closed if there's no room for it
+static bool add_active_device(ohmd_context* ctx, ohmd_device* device)
 {
-	ctx->update_request_quit = true;
+	ohmd_lock_mutex(ctx->update_mutex);
 
-	for(int i = 0; i < ctx->num_active_devices; i++){
-		ctx->active_devices[i]->close(ctx->active_devices[i]);
+	if(!ohmd_grow_array((void**)&ctx->active_devices, &ctx->num_allocated_active_devices,
+	                    ctx->num_active_devices + 1, sizeof(ohmd_device*))){
+		ohmd_unlock_mutex(ctx->update_mutex);
+		close_device_unp(device);
+		ohmd_set_error(ctx, "could not allocate RAM for device");
+		return false;
 	}
 
-	for(int i = 0; i < ctx->num_drivers; i++){
-		ctx->drivers[i]->destroy(ctx->drivers[i]);
-	}
+	device->active_device_idx = ctx->num_active_devices;
+	ctx->active_devices[ctx->num_active_devices++] = device;
 
-	if(ctx->update_thread){
-		ohmd_destroy_thread(ctx->update_thread);
-		ohmd_destroy_mutex(ctx->update_mutex);
-	}
+	if(device->settings.automatic_update && device->settings.update_mode == OHMD_UPDATE_MODE_SHARED)
+		ohmd_set_up_update_thread(ctx);
 
-	free(ctx);
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	// the shared update thread may be waiting on the devices it had so far
+	ohmd_device_signal_data(device);
+
+	return true;
 }
 
-void OHMD_APIENTRY ohmd_ctx_update(ohmd_context* ctx)
+ohmd_device* OHMD_APIENTRY ohmd_list_open_device_s(ohmd_context* ctx, int index, ohmd_device_settings* settings)
 {
-	for(int i = 0; i < ctx->num_active_devices; i++){
-		ohmd_device* dev = ctx->active_devices[i];
-		if(!dev->settings.automatic_update && dev->update)
-			dev->update(dev);
-	
-		ohmd_lock_mutex(ctx->update_mutex);
-		dev->getf(dev, OHMD_POSITION_VECTOR, (float*)&dev->position);
-		dev->getf(dev, OHMD_ROTATION_QUAT, (float*)&dev->rotation);
-		ohmd_unlock_mutex(ctx->update_mutex);
-	}
+	ohmd_device_desc desc;
+	if(!get_list_entry(ctx, index, &desc))
+		return NULL;
+
+	ohmd_device* device = open_device_unp(ctx, &desc, settings);
+	if(!device || !add_active_device(ctx, device))
+		return NULL;
+
+	return device;
 }
 
-const char* OHMD_APIENTRY ohmd_ctx_get_error(ohmd_context* ctx)
+typedef struct {
+	ohmd_context* ctx;
+	ohmd_device_desc desc;
+	ohmd_device_settings* settings;
+	ohmd_device* device;
+	ohmd_thread* thread;
+} open_worker;
+
+static unsigned int open_worker_thread(void* arg)
 {
-	return ctx->error_msg;
+	open_worker* worker = (open_worker*)arg;
+	worker->device = open_device_unp(worker->ctx, &worker->desc, worker->settings);
+	return 0;
 }
 
-int OHMD_APIENTRY ohmd_ctx_probe(ohmd_context* ctx)
+int OHMD_APIENTRY ohmd_list_open_devices(ohmd_context* ctx, int count, const int* indices, ohmd_device_settings* settings, ohmd_device** out_devices)
 {
-	memset(&ctx->list, 0, sizeof(ohmd_device_list));
-	for(int i = 0; i < ctx->num_drivers; i++){
-		ctx->drivers[i]->get_device_list(ctx->drivers[i], &ctx->list);
+	ohmd_device_settings default_settings;
+	if(!settings){
+		ohmd_set_default_device_settings(&default_settings);
+		settings = &default_settings;
+	}
+
+	for(int i = 0; i < count; i++)
+		out_devices[i] = NULL;
+
+	open_worker* workers = calloc(count > 0 ? count : 1, sizeof(open_worker));
+	if(!workers){
+		ohmd_set_error(ctx, "could not allocate RAM for device");
+		return 0;
+	}
+
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	for(int i = 0; i < count; i++){
+		workers[i].ctx = ctx;
+		workers[i].settings = settings;
+
+		// invalid indices are left without a driver and skipped
+		if(indices[i] >= 0 && indices[i] < ctx->list.num_devices)
+			workers[i].desc = ctx->list.devices[indices[i]];
+	}
+
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	int last = -1;
+	for(int i = 0; i < count; i++){
+		if(!workers[i].desc.driver_ptr){
+			ohmd_set_error(ctx, "no device with index: %d", indices[i]);
+			continue;
+		}
+
+		// the last device is opened on this thread, as is any device a thread can't be started for
+		if(last >= 0){
+			workers[last].thread = ohmd_create_thread(ctx, open_worker_thread, &workers[last]);
+			if(!workers[last].thread)
+				open_worker_thread(&workers[last]);
+		}
+
+		last = i;
+	}
+
+	if(last >= 0)
+		open_worker_thread(&workers[last]);
+
+	int num_opened = 0;
+	for(int i = 0; i < count; i++){
+		if(workers[i].thread)
+			ohmd_destroy_thread(workers[i].thread);
+
+		if(workers[i].device && add_active_device(ctx, workers[i].device)){
+			out_devices[i] = workers[i].device;
+			num_opened++;
+		}
 	}
 
-	return ctx->list.num_devices;
+	free(workers);
+
+	return num_opened;
 }
 
-const char* OHMD_APIENTRY ohmd_list_gets(ohmd_context* ctx, int index, ohmd_string_value type)
+ohmd_device* OHMD_APIENTRY ohmd_list_open_device(ohmd_context* ctx, int index)
 {
-	if(index >= ctx->list.num_devices)
-		return NULL;
+	ohmd_device_settings settings;
 
-	switch(type){
-	case OHMD_VENDOR:
-		return ctx->list.devices[index].vendor;
-	case OHMD_PRODUCT:
-		return ctx->list.devices[index].product;
-	case OHMD_PATH:
-		return ctx->list.devices[index].path;
-	default:
-		return NULL;
-	}
+	ohmd_set_default_device_settings(&settings);
+
+	return ohmd_list_open_device_s(ctx, index, &settings);
 }
 
-static unsigned int ohmd_update_thread(void* arg)
+OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_close_device(ohmd_device* device)
 {
-	ohmd_context* ctx = (ohmd_context*)arg;
-	
-	while(!ctx->update_request_quit)
-	{
-		ohmd_lock_mutex(ctx->update_mutex);
+	ohmd_context* ctx = device->ctx;
 
-		for(int i = 0; i < ctx->num_active_devices; i++){
-			if(ctx->active_devices[i]->settings.automatic_update && ctx->active_devices[i]->update)
-				ctx->active_devices[i]->update(ctx->active_devices[i]);
+	// A pose callback runs on the thread updating the device, which would wait for itself
+	// to finish with the device. The shared update thread holds all of its devices.
+	if((device->update_thread && ohmd_is_current_thread(device->update_thread)) ||
+	   (ctx->update_thread && ohmd_is_current_thread(ctx->update_thread) && is_shared_update_device(device))){
+		ohmd_set_error(ctx, "can't close a device from the thread updating it");
+		return OHMD_S_INVALID_PARAMETER;
+	}
+
+	ohmd_lock_mutex(ctx->update_mutex);
+
+	// move the last device into the freed slot
+	int idx = device->active_device_idx;
+	ohmd_device* last = ctx->active_devices[--ctx->num_active_devices];
+
+	ctx->active_devices[idx] = last;
+	last->active_device_idx = idx;
+
+	// let threads working with the device without the context lock finish
+	if(device->num_unlocked_users > 0){
+		ctx->num_release_waiters++;
+
+		while(device->num_unlocked_users > 0){
+			unsigned int release_seq = ctx->release_seq;
+
+			ohmd_unlock_mutex(ctx->update_mutex);
+			ohmd_wait_cond(ctx->release_cond, &ctx->release_seq, release_seq, AUTOMATIC_UPDATE_WAIT_TIMEOUT);
+			ohmd_lock_mutex(ctx->update_mutex);
 		}
-		
-		ohmd_unlock_mutex(ctx->update_mutex);
 
-		ohmd_sleep(AUTOMATIC_UPDATE_SLEEP);
+		ctx->num_release_waiters--;
 	}
 
-	return 0;
+	ohmd_unlock_mutex(ctx->update_mutex);
+
+	// no longer reachable from the update thread, wait out any setf still in progress
+	ohmd_lock_mutex(device->update_mutex);
+	ohmd_unlock_mutex(device->update_mutex);
+
+	close_device_unp(device);
+
+	return OHMD_S_OK;
 }
 
-static void ohmd_set_up_update_thread(ohmd_context* ctx)
+// applies the rotation correction the way OHMD_ROTATION_QUAT reports it
+static void correct_rotation(const quatf* correction, const quatf* rot, quatf* out)
 {
-	if(!ctx->update_thread){
-		ctx->update_mutex = ohmd_create_mutex(ctx);
-		ctx->update_thread = ohmd_create_thread(ctx, ohmd_update_thread, ctx);
-	}
+	quatf tmp = *rot;
+	oquatf_mult_me(&tmp, correction);
+	oquatf_mult(correction, &tmp, out);
 }
 
-ohmd_device* OHMD_APIENTRY ohmd_list_open_device_s(ohmd_context* ctx, int index, ohmd_device_settings* settings)
+void ohmd_device_publish_pose(ohmd_device* device)
 {
-	ohmd_lock_mutex(ctx->update_mutex);
+	ohmd_pose pose;
+	vec3f point = {{0, 0, 0}};
+	mat4x4f orient, world_shift, result;
+
+	pose.rotation_correction = device->rotation_correction;
+	correct_rotation(&device->rotation_correction, &device->rotation, &pose.rotation);
+
+	for(int i = 0; i < 3; i++)
+		pose.position.arr[i] = device->position.arr[i] + device->position_correction.arr[i];
+
+	// both eyes share the orientation of the corrected rotation
+	omat4x4f_init_look_at(&orient, &pose.rotation, &point);
+
+	// left eye
+	omat4x4f_init_translate(&world_shift, +(device->properties.ipd / 2.0f), 0, 0);
+	omat4x4f_mult(&world_shift, &orient, &result);
+	omat4x4f_transpose(&result, &pose.modelview_left);
+
+	// right eye
+	omat4x4f_init_translate(&world_shift, -(device->properties.ipd / 2.0f), 0, 0);
+	omat4x4f_mult(&world_shift, &orient, &result);
+	omat4x4f_transpose(&result, &pose.modelview_right);
+
+	omat4x4f_transpose(&device->properties.proj_left, &pose.proj_left);
+	omat4x4f_transpose(&device->properties.proj_right, &pose.proj_right);
+
+	// samples are pushed under the device lock as well
+	pose.sample = device->num_samples;
+	pose.time = pose.sample > 0 ? SAMPLE_AT(device, pose.sample - 1)->time : 0;
+
+	// an odd sequence number tells readers that a write is in progress
+	device->pose_seq++;
+	ohmd_memory_barrier();
+	device->pose = pose;
+	ohmd_memory_barrier();
+	device->pose_seq++;
+}
 
-	if(index >= 0 && index < ctx->list.num_devices){
+void ohmd_device_read_pose(ohmd_device* device, ohmd_pose* out)
+{
+	unsigned int seq;
+
+	// retry until a copy was made without the writer interfering
+	do {
+		seq = device->pose_seq;
+		ohmd_memory_barrier();
+		*out = device->pose;
+		ohmd_memory_barrier();
+	} while((seq & 1) || seq != device->pose_seq);
+}
 
-		ohmd_device_desc* desc = &ctx->list.devices[index];
-		ohmd_driver* driver = (ohmd_driver*)desc->driver_ptr;
-		ohmd_device* device = driver->open_device(driver, desc);
+// Never predict further ahead than this, in seconds
+#define PREDICTION_MAX_TIME (100.0 / 1000.0)
+// How many samples back the angular acceleration is estimated over
+#define PREDICTION_ACCEL_SAMPLES 10
 
-		if (device == NULL)
-			return NULL;
+void ohmd_device_push_sample(ohmd_device* device, double time, const quatf* orient, const vec3f* ang_vel)
+{
+	ohmd_pose_sample* sample = SAMPLE_AT(device, device->num_samples);
+
+	sample->time = time;
+	sample->orient = *orient;
+	sample->ang_vel = *ang_vel;
 
-		device->rotation_correction.w = 1;
+	// only count the sample once it has been written
+	ohmd_memory_barrier();
+	device->num_samples++;
 
-		device->settings = *settings;
+	ohmd_signal_cond(device->sample_cond);
+}
 
-		device->ctx = ctx;
-		device->active_device_idx = ctx->num_active_devices;
-		ctx->active_devices[ctx->num_active_devices++] = device;
+void ohmd_device_signal_data(ohmd_device* device)
+{
+	ohmd_context* ctx = device->ctx;
 
-		ohmd_unlock_mutex(ctx->update_mutex);
+	ctx->data_seq++;
+	ohmd_signal_cond(ctx->data_cond);
+}
 
-		if(device->settings.automatic_update)
-			ohmd_set_up_update_thread(ctx);
+// extrapolate the orientation of the newest sample, older is used to estimate the angular acceleration
+static void predict_rotation(const ohmd_pose_sample* newest, const ohmd_pose_sample* older, double ahead, quatf* out)
+{
+	float dt = (float)OHMD_MIN(ahead, PREDICTION_MAX_TIME);
+	vec3f ang_vel = newest->ang_vel;
 
-		return device;
+	// with a constant angular acceleration, the mean angular velocity
+	// over the prediction is the one reached half way through it
+	double span = newest->time - older->time;
+	if(span > 0){
+		for(int i = 0; i < 3; i++)
+			ang_vel.arr[i] += (float)((newest->ang_vel.arr[i] - older->ang_vel.arr[i]) / span) * dt / 2.0f;
 	}
 
-	ohmd_unlock_mutex(ctx->update_mutex);
+	*out = newest->orient;
 
-	ohmd_set_error(ctx, "no device with index: %d", index);
-	return NULL;
+	// same integration step as ofusion_update
+	float ang_vel_length = ovec3f_get_length(&ang_vel);
+	if(ang_vel_length > 0.0001f){
+		vec3f rot_axis =
+			{{ ang_vel.x / ang_vel_length, ang_vel.y / ang_vel_length, ang_vel.z / ang_vel_length }};
+
+		quatf delta_orient;
+		oquatf_init_axis(&delta_orient, &rot_axis, ang_vel_length * dt);
+		oquatf_mult_me(out, &delta_orient);
+	}
 }
 
-ohmd_device* OHMD_APIENTRY ohmd_list_open_device(ohmd_context* ctx, int index)
+int OHMD_APIENTRY ohmd_device_get_pose_at(ohmd_device* device, double time, float* out)
 {
-	ohmd_device_settings settings;
+	ohmd_pose_sample before, after, older;
+	unsigned int count, first, lo, hi, ref;
+
+	// Find the samples around time, retry if the oldest one we used got
+	// overwritten by the driver while we were looking.
+	do {
+		count = device->num_samples;
+		ohmd_memory_barrier();
+
+		if(count == 0)
+			return OHMD_S_UNSUPPORTED;
+
+		// the slot after the newest sample may be in the middle of being overwritten
+		first = count >= OHMD_POSE_HISTORY_SIZE ? count - (OHMD_POSE_HISTORY_SIZE - 1) : 0;
+		lo = first;
+		hi = ref = count - 1;
+
+		if(time <= SAMPLE_AT(device, lo)->time){
+			hi = lo;
+		}else if(time >= SAMPLE_AT(device, hi)->time){
+			lo = hi;
+			ref = hi - OHMD_MIN(PREDICTION_ACCEL_SAMPLES, hi - first);
+		}else{
+			while(hi - lo > 1){
+				unsigned int mid = lo + (hi - lo) / 2;
+				if(SAMPLE_AT(device, mid)->time <= time)
+					lo = mid;
+				else
+					hi = mid;
+			}
+		}
 
-	settings.automatic_update = true;
+		before = *SAMPLE_AT(device, lo);
+		after = *SAMPLE_AT(device, hi);
+		older = *SAMPLE_AT(device, ref);
 
-	return ohmd_list_open_device_s(ctx, index, &settings);
+		ohmd_memory_barrier();
+	} while(device->num_samples - OHMD_MIN(lo, ref) >= OHMD_POSE_HISTORY_SIZE);
+
+	quatf rot = before.orient;
+	if(after.time > before.time)
+		oquatf_slerp((float)((time - before.time) / (after.time - before.time)), &before.orient, &after.orient, true, &rot);
+	else if(time > before.time)
+		predict_rotation(&before, &older, time - before.time, &rot);
+
+	ohmd_pose pose;
+	ohmd_device_read_pose(device, &pose);
+	correct_rotation(&pose.rotation_correction, &rot, (quatf*)out);
+
+	return OHMD_S_OK;
 }
 
-OHMD_APIENTRYDLL int OHMD_APIENTRY ohmd_close_device(ohmd_device* device)
+int OHMD_APIENTRY ohmd_device_get_sample_time(ohmd_device* device, double* out)
 {
-	ohmd_lock_mutex(device->ctx->update_mutex);
+	ohmd_pose pose;
+	ohmd_device_read_pose(device, &pose);
 
-	ohmd_context* ctx = device->ctx;
-	int idx = device->active_device_idx;
+	*out = pose.time;
+
+	return OHMD_S_OK;
+}
 
-	memmove(ctx->active_devices + idx, ctx->active_devices + idx + 1,
-		sizeof(ohmd_device*) * (ctx->num_active_devices - idx - 1));
+int OHMD_APIENTRY ohmd_device_wait_for_sample(ohmd_device* device, unsigned int last_sample, double timeout, unsigned int* out_sample)
+{
+	double deadline = ohmd_get_tick() + timeout;
+	unsigned int sample = device->num_samples;
+
+	// newer rather than just different, a last_sample ahead of the device waits as well,
+	// compared so the numbers can wrap around
+	while((int)(sample - last_sample) <= 0){
+		double left = deadline - ohmd_get_tick();
+		if(left <= 0)
+			break;
+
+		ohmd_wait_cond(device->sample_cond, &device->num_samples, sample, left);
+		sample = device->num_samples;
+	}
 
-	device->close(device);
+	*out_sample = sample;
+
+	return (int)(sample - last_sample) > 0 ? OHMD_S_OK : OHMD_S_TIMEOUT;
+}
+
+int OHMD_APIENTRY ohmd_device_set_pose_callback(ohmd_device* device, ohmd_pose_callback callback, void* user_data)
+{
+	ohmd_lock_mutex(device->update_mutex);
 
-	ctx->num_active_devices--;
+	device->pose_callback = callback;
+	device->pose_callback_data = user_data;
 
-	for(int i = idx; i < ctx->num_active_devices; i++)
-		ctx->active_devices[i]->active_device_idx--;
-	
-	ohmd_unlock_mutex(device->ctx->update_mutex);
+	// only samples arriving from now on are delivered
+	device->pose_callback_sample = device->num_samples;
+
+	ohmd_unlock_mutex(device->update_mutex);
 
 	return OHMD_S_OK;
 }
 
+// hands the samples that arrived since the last call to the pose callback, call without holding any locks
+static void dispatch_pose_callback(ohmd_device* dev)
+{
+	ohmd_lock_mutex(dev->update_mutex);
+
+	ohmd_pose_callback callback = dev->pose_callback;
+	void* user_data = dev->pose_callback_data;
+	unsigned int next = dev->pose_callback_sample;
+	unsigned int count = dev->num_samples;
+
+	dev->pose_callback_sample = count;
+
+	ohmd_unlock_mutex(dev->update_mutex);
+
+	if(!callback)
+		return;
+
+	if(count - next >= OHMD_POSE_HISTORY_SIZE)
+		next = count - (OHMD_POSE_HISTORY_SIZE - 1);
+
+	for(; next != count; next++){
+		ohmd_pose_sample sample = *SAMPLE_AT(dev, next);
+		ohmd_memory_barrier();
+
+		// overwritten while earlier callbacks were running
+		if(dev->num_samples - next >= OHMD_POSE_HISTORY_SIZE)
+			continue;
+
+		ohmd_pose pose;
+		quatf rot;
+
+		ohmd_device_read_pose(dev, &pose);
+		correct_rotation(&pose.rotation_correction, &sample.orient, &rot);
+
+		callback(dev, sample.time, (float*)&rot, (float*)&pose.position, user_data);
+	}
+}
+
 static int ohmd_device_getf_unp(ohmd_device* device, ohmd_float_value type, float* out)
 {
 	switch(type){
-	case OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX: {
-			vec3f point = {{0, 0, 0}};
-			quatf rot = device->rotation;
-			quatf tmp = device->rotation_correction;
-			oquatf_mult_me(&tmp, &rot);
-			rot = tmp;
-			mat4x4f orient, world_shift, result;
-			omat4x4f_init_look_at(&orient, &rot, &point);
-			omat4x4f_init_translate(&world_shift, +(device->properties.ipd / 2.0f), 0, 0);
-			omat4x4f_mult(&world_shift, &orient, &result);
-			omat4x4f_transpose(&result, (mat4x4f*)out);
-			return OHMD_S_OK;
-		}
-	case OHMD_RIGHT_EYE_GL_MODELVIEW_MATRIX: {
-			vec3f point = {{0, 0, 0}};
-			quatf rot = device->rotation;
-			oquatf_mult_me(&rot, &device->rotation_correction);
-			mat4x4f orient, world_shift, result;
-			omat4x4f_init_look_at(&orient, &rot, &point);
-			omat4x4f_init_translate(&world_shift, -(device->properties.ipd / 2.0f), 0, 0);
-			omat4x4f_mult(&world_shift, &orient, &result);
-			omat4x4f_transpose(&result, (mat4x4f*)out);
-			return OHMD_S_OK;
-		}
 	case OHMD_LEFT_EYE_GL_PROJECTION_MATRIX:
 		omat4x4f_transpose(&device->properties.proj_left, (mat4x4f*)out);
 		return OHMD_S_OK;
@@ -271,40 +1470,114 @@ static int ohmd_device_getf_unp(ohmd_device* device, ohmd_float_value type, floa
 		*out = device->properties.znear;
 		return OHMD_S_OK;
 
-	case OHMD_ROTATION_QUAT:
-	{
-		*(quatf*)out = device->rotation;
-
-		oquatf_mult_me((quatf*)out, &device->rotation_correction);
-		quatf tmp = device->rotation_correction;
-		oquatf_mult_me(&tmp, (quatf*)out);
-		*(quatf*)out = tmp;
-		return OHMD_S_OK;
+	default:
+		return device->getf(device, type, out);
 	}
-	case OHMD_POSITION_VECTOR:
-	{
-		*(vec3f*)out = device->position;
-
-		for(int i = 0; i < 3; i++)
-			out[i] += device->position_correction.arr[i];
+}
 
-		return OHMD_S_OK;
+// the values that are read from the published pose and never wait for the update thread
+static bool is_pose_value(ohmd_float_value type)
+{
+	switch(type){
+	case OHMD_ROTATION_QUAT:
+	case OHMD_POSITION_VECTOR:
+	case OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX:
+	case OHMD_RIGHT_EYE_GL_MODELVIEW_MATRIX:
+		return true;
+	default:
+		return false;
 	}
+}
 
+static void getf_pose(const ohmd_pose* pose, ohmd_float_value type, float* out)
+{
+	switch(type){
+	case OHMD_ROTATION_QUAT:
+		*(quatf*)out = pose->rotation;
+		break;
+	case OHMD_POSITION_VECTOR:
+		*(vec3f*)out = pose->position;
+		break;
+	case OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX:
+		*(mat4x4f*)out = pose->modelview_left;
+		break;
+	case OHMD_RIGHT_EYE_GL_MODELVIEW_MATRIX:
+		*(mat4x4f*)out = pose->modelview_right;
+		break;
 	default:
-		return device->getf(device, type, out);
+		break;
 	}
 }
 
 int OHMD_APIENTRY ohmd_device_getf(ohmd_device* device, ohmd_float_value type, float* out)
 {
-	ohmd_lock_mutex(device->ctx->update_mutex);
+	if(is_pose_value(type)){
+		ohmd_pose pose;
+		ohmd_device_read_pose(device, &pose);
+		getf_pose(&pose, type, out);
+		return OHMD_S_OK;
+	}
+
+	ohmd_lock_mutex(device->update_mutex);
 	int ret = ohmd_device_getf_unp(device, type, out);
-	ohmd_unlock_mutex(device->ctx->update_mutex);
+	ohmd_unlock_mutex(device->update_mutex);
+
+	return ret;
+}
+
+int OHMD_APIENTRY ohmd_device_getf_multi(ohmd_device* device, int count, const ohmd_float_value* types, float* const* out)
+{
+	ohmd_pose pose;
+	bool need_lock = false;
+	int ret = OHMD_S_OK;
+
+	// every pose value comes from the same snapshot
+	ohmd_device_read_pose(device, &pose);
+
+	for(int i = 0; i < count; i++){
+		if(is_pose_value(types[i]))
+			getf_pose(&pose, types[i], out[i]);
+		else
+			need_lock = true;
+	}
+
+	if(!need_lock)
+		return OHMD_S_OK;
+
+	ohmd_lock_mutex(device->update_mutex);
+
+	for(int i = 0; i < count; i++){
+		if(!is_pose_value(types[i])){
+			int value_ret = ohmd_device_getf_unp(device, types[i], out[i]);
+			if(value_ret != OHMD_S_OK && ret == OHMD_S_OK)
+				ret = value_ret;
+		}
+	}
+
+	ohmd_unlock_mutex(device->update_mutex);
 
 	return ret;
 }
 
+int OHMD_APIENTRY ohmd_device_get_frame(ohmd_device* device, ohmd_frame* out)
+{
+	ohmd_pose pose;
+	ohmd_device_read_pose(device, &pose);
+
+	memcpy(out->modelview_left, &pose.modelview_left, sizeof(out->modelview_left));
+	memcpy(out->modelview_right, &pose.modelview_right, sizeof(out->modelview_right));
+	memcpy(out->projection_left, &pose.proj_left, sizeof(out->projection_left));
+	memcpy(out->projection_right, &pose.proj_right, sizeof(out->projection_right));
+	memcpy(out->rotation, &pose.rotation, sizeof(out->rotation));
+	memcpy(out->position, &pose.position, sizeof(float) * 3);
+	out->position[3] = 1.0f;
+
+	out->time = pose.time;
+	out->sample = pose.sample;
+
+	return OHMD_S_OK;
+}
+
 int ohmd_device_setf_unp(ohmd_device* device, ohmd_float_value type, const float* in)
 {
 	switch(type){
@@ -359,9 +1632,22 @@ int ohmd_device_setf_unp(ohmd_device* device, ohmd_float_value type, const float
 
 int OHMD_APIENTRY ohmd_device_setf(ohmd_device* device, ohmd_float_value type, const float* in)
 {
-	ohmd_lock_mutex(device->ctx->update_mutex);
+	ohmd_lock_mutex(device->update_mutex);
 	int ret = ohmd_device_setf_unp(device, type, in);
-	ohmd_unlock_mutex(device->ctx->update_mutex);
+
+	// corrections, ipd and externally fused samples all change the published pose
+	if(ret == OHMD_S_OK){
+		device->pose_dirty = true;
+		update_pose(device);
+	}
+
+	bool dispatch = has_pose_callback_samples(device);
+
+	ohmd_unlock_mutex(device->update_mutex);
+
+	// externally fused samples arrive here rather than through an update
+	if(dispatch)
+		dispatch_pose_callback(device);
 
 	return ret;
 }
@@ -375,7 +1661,30 @@ int OHMD_APIENTRY ohmd_device_geti(ohmd_device* device, ohmd_int_value type, int
 	case OHMD_SCREEN_VERTICAL_RESOLUTION:
 		*out = device->properties.vres;
 		return OHMD_S_OK;
+	case OHMD_SUPPORTED_FLOAT_VALUES:
+		*out = device->supported_float_values;
+		return OHMD_S_OK;
+	case OHMD_SUPPORTED_INT_VALUES:
+		*out = device->supported_int_values;
+		return OHMD_S_OK;
+	case OHMD_SAMPLE_NUMBER: {
+			ohmd_pose pose;
+			ohmd_device_read_pose(device, &pose);
+			*out = (int)pose.sample;
+			return OHMD_S_OK;
+		}
+	case OHMD_POSE_GENERATION:
+		// pose_seq goes up by two for every publish
+		*out = (int)(device->pose_seq >> 1);
+		return OHMD_S_OK;
 	default:
+		if(device->geti){
+			ohmd_lock_mutex(device->update_mutex);
+			int ret = device->geti(device, type, out);
+			ohmd_unlock_mutex(device->update_mutex);
+			return ret;
+		}
+
 		return OHMD_S_INVALID_PARAMETER;
 	}
 }
@@ -407,9 +1716,14 @@ int ohmd_device_set_data_unp(ohmd_device* device, ohmd_data_value type, const vo
 
 int OHMD_APIENTRY ohmd_device_set_data(ohmd_device* device, ohmd_data_value type, const void* in)
 {
-	ohmd_lock_mutex(device->ctx->update_mutex);
+	ohmd_lock_mutex(device->update_mutex);
 	int ret = ohmd_device_set_data_unp(device, type, in);
-	ohmd_unlock_mutex(device->ctx->update_mutex);
+
+	// driver properties may change what the pose is built from, picked up by the next update
+	if(ret == OHMD_S_OK)
+		device->pose_dirty = true;
+
+	ohmd_unlock_mutex(device->update_mutex);
 
 	return ret;
 }
@@ -420,6 +1734,27 @@ ohmd_status OHMD_APIENTRY ohmd_device_settings_seti(ohmd_device_settings* settin
 	case OHMD_IDS_AUTOMATIC_UPDATE:
 		settings->automatic_update = val[0] == 0 ? false : true;
 		return OHMD_S_OK;
+
+	case OHMD_IDS_UPDATE_MODE:
+		if(val[0] != OHMD_UPDATE_MODE_SHARED && val[0] != OHMD_UPDATE_MODE_DEDICATED)
+			return OHMD_S_INVALID_PARAMETER;
+
+		settings->update_mode = (ohmd_update_mode)val[0];
+		return OHMD_S_OK;
+
+	case OHMD_IDS_UPDATE_RATE:
+		if(val[0] < 0)
+			return OHMD_S_INVALID_PARAMETER;
+
+		settings->update_rate = val[0];
+		return OHMD_S_OK;
+
+	case OHMD_IDS_UPDATE_CPU:
+		if(val[0] < -1)
+			return OHMD_S_INVALID_PARAMETER;
+
+		settings->update_cpu = val[0];
+		return OHMD_S_OK;
     
 	default:
 		return OHMD_S_INVALID_PARAMETER;
@@ -428,7 +1763,11 @@ ohmd_status OHMD_APIENTRY ohmd_device_settings_seti(ohmd_device_settings* settin
 
 ohmd_device_settings* OHMD_APIENTRY ohmd_device_settings_create(ohmd_context* ctx)
 {
-	return ohmd_alloc(ctx, sizeof(ohmd_device_settings));
+	ohmd_device_settings* settings = ohmd_alloc(ctx, sizeof(ohmd_device_settings));
+	if(settings)
+		ohmd_set_default_device_settings(settings);
+
+	return settings;
 }
 
 void OHMD_APIENTRY ohmd_device_settings_destroy(ohmd_device_settings* settings)
@@ -436,6 +1775,11 @@ void OHMD_APIENTRY ohmd_device_settings_destroy(ohmd_device_settings* settings)
 	free(settings);
 }
 
+double OHMD_APIENTRY ohmd_get_time(void)
+{
+	return ohmd_get_tick();
+}
+
 void* ohmd_allocfn(ohmd_context* ctx, const char* e_msg, size_t size)
 {
 	void* ret = calloc(1, size);
@@ -444,6 +1788,34 @@ void* ohmd_allocfn(ohmd_context* ctx, const char* e_msg, size_t size)
 	return ret;
 }
 
+bool ohmd_grow_array(void** array, int* num_allocated, int min_size, size_t elem_size)
+{
+	if(min_size <= *num_allocated)
+		return true;
+
+	// doubling keeps appending O(1) on average
+	int size = OHMD_MAX(*num_allocated * 2, OHMD_MAX(min_size, 8));
+	void* grown = realloc(*array, size * elem_size);
+	if(!grown)
+		return false;
+
+	*array = grown;
+	*num_allocated = size;
+
+	return true;
+}
+
+ohmd_device_desc* ohmd_device_list_add(ohmd_device_list* list)
+{
+	if(!ohmd_grow_array((void**)&list->devices, &list->num_allocated, list->num_devices + 1, sizeof(ohmd_device_desc)))
+		return NULL;
+
+	ohmd_device_desc* desc = &list->devices[list->num_devices++];
+	memset(desc, 0, sizeof(ohmd_device_desc));
+
+	return desc;
+}
+
 void ohmd_set_default_device_properties(ohmd_device_properties* props)
 {
 	props->ipd = 0.061f;
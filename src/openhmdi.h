@@ -13,13 +13,14 @@
 #include "openhmd.h"
 #include "omath.h"
 #include "platform.h"
+#include "ring.h"
 
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#define OHMD_MAX_DEVICES 16
+#define OHMD_POSE_HISTORY_SIZE 256 // must be a power of two
 
 #define OHMD_MAX(_a, _b) ((_a) > (_b) ? (_a) : (_b))
 #define OHMD_MIN(_a, _b) ((_a) < (_b) ? (_a) : (_b))
@@ -34,13 +35,16 @@ typedef struct
 	char vendor[OHMD_STR_SIZE];
 	char product[OHMD_STR_SIZE];
 	char path[OHMD_STR_SIZE];
+	char serial[OHMD_STR_SIZE]; // empty if the driver can't tell devices apart
 	int revision;
+	int id; // assigned when probing, stays the same for as long as the device is listed
 	ohmd_driver* driver_ptr;
 } ohmd_device_desc;
 
 typedef struct {
 	int num_devices;
-	ohmd_device_desc devices[OHMD_MAX_DEVICES];
+	int num_allocated;
+	ohmd_device_desc* devices; // add entries with ohmd_device_list_add
 } ohmd_device_list;
 
 struct ohmd_driver {
@@ -48,6 +52,9 @@ struct ohmd_driver {
 	ohmd_device* (*open_device)(ohmd_driver* driver, ohmd_device_desc* desc);
 	void (*destroy)(ohmd_driver* driver);
 	ohmd_context* ctx;
+
+	// set by drivers that list HID devices, only they are enumerated again when a hidraw node is added
+	bool hid_devices;
 };
 
 typedef struct {
@@ -72,11 +79,40 @@ typedef struct {
 		mat4x4f proj_right; // adjusted projection matrix for right screen
 } ohmd_device_properties;
 
+struct ohmd_ctx_settings
+{
+	int drivers;
+	bool lazy_drivers;
+};
+
 struct ohmd_device_settings
 {
 	bool automatic_update;
+	ohmd_update_mode update_mode;
+	int update_rate;
+	int update_cpu;
 };
 
+// corrected pose and the values derived from it, as handed out by ohmd_device_getf
+typedef struct {
+	quatf rotation;
+	quatf rotation_correction;
+	vec3f position;
+	mat4x4f modelview_left;  // transposed, "ready to use" OpenGL matrices
+	mat4x4f modelview_right;
+	mat4x4f proj_left;
+	mat4x4f proj_right;
+	double time; // time of the newest sample when published
+	unsigned int sample; // number of samples when published
+} ohmd_pose;
+
+// a fused orientation sample, as kept in the device pose history
+typedef struct {
+	double time; // host time in seconds, see ohmd_get_tick
+	quatf orient;
+	vec3f ang_vel;
+} ohmd_pose_sample;
+
 struct ohmd_device {
 	ohmd_device_properties properties;
 
@@ -85,34 +121,119 @@ struct ohmd_device {
 
 	int (*getf)(ohmd_device* device, ohmd_float_value type, float* out);
 	int (*setf)(ohmd_device* device, ohmd_float_value type, const float* in);
+	int (*geti)(ohmd_device* device, ohmd_int_value type, int* out);
 	int (*seti)(ohmd_device* device, ohmd_int_value type, const int* in);
 	int (*set_data)(ohmd_device* device, ohmd_data_value type, const void* in);
 
 	void (*update)(ohmd_device* device);
 	void (*close)(ohmd_device* device);
 
+	// optional, block for up to timeout seconds until update() has data to process,
+	// called from the update thread without the device lock so it may only touch state
+	// that belongs to update(), returns true if data arrived. Drivers setting it also call
+	// ohmd_device_signal_data whenever data arrives, the shared update thread waits for
+	// all of its devices at once that way.
+	bool (*wait_for_data)(ohmd_device* device, double timeout);
+
+	// the values getf handles besides rotation and position, as a mask of
+	// (1 << ohmd_float_value) bits, set by the driver in open_device
+	int driver_float_values;
+	// likewise for geti, all of which are left to the driver
+	int driver_int_values;
+
 	ohmd_context* ctx;
 
+	// values ohmd_device_getf and ohmd_device_geti can read, computed when the device is opened
+	int supported_float_values;
+	int supported_int_values;
+
+	// serializes update, setf and driver getf calls for this device only
+	ohmd_mutex* update_mutex;
+
+	// dedicated update thread, if OHMD_UPDATE_MODE_DEDICATED is used,
+	// it waits on sample_cond between fixed rate updates so setting quit wakes it
+	ohmd_thread* update_thread;
+	volatile unsigned int update_request_quit;
+
 	ohmd_device_settings settings;
 
-	int active_device_idx; // index into ohmd_device->active_devices[]
+	int active_device_idx; // index into ohmd_context->active_devices[]
+
+	// threads working with the device after releasing the context update_mutex,
+	// guarded by it, ohmd_close_device waits on release_cond for this to drop to zero
+	int num_unlocked_users;
 
 	quatf rotation;
 	vec3f position;
+
+	// published pose, written under the device update_mutex and read lock-free
+	// sequence lock style, pose_seq is odd while a write is in progress
+	volatile unsigned int pose_seq;
+	ohmd_pose pose;
+	bool pose_dirty; // set when a correction or property the pose depends on changes
+
+	// ring of recently fused samples, written by the driver under update_mutex and read lock-free,
+	// sample number n is stored at samples[n % OHMD_POSE_HISTORY_SIZE]
+	volatile unsigned int num_samples;
+	ohmd_pose_sample samples[OHMD_POSE_HISTORY_SIZE];
+
+	// signalled whenever num_samples changes
+	ohmd_cond* sample_cond;
+
+	// pose callback and the next sample number it gets, guarded by update_mutex
+	ohmd_pose_callback pose_callback;
+	void* pose_callback_data;
+	unsigned int pose_callback_sample;
 };
 
 
 struct ohmd_context {
-	ohmd_driver* drivers[16];
+	ohmd_driver** drivers;
 	int num_drivers;
+	int num_allocated_drivers;
 
-	ohmd_device_list list;
+	int enabled_drivers; // ohmd_driver_flags of the drivers to create
+	bool drivers_created;
 
-	ohmd_device* active_devices[256];
+	ohmd_device_list list;
+	int last_device_id;
+
+	// ohmd_list_gets points into the list, so lists replaced by probing are kept until the context is destroyed
+	ohmd_device_desc** retired_lists;
+	int num_retired_lists;
+	int num_allocated_retired_lists;
+
+	// asynchronous probing, probe_running is 1 while a probe is in progress
+	ohmd_thread* probe_thread;
+	ohmd_cond* probe_cond;
+	volatile unsigned int probe_running;
+	int probe_result;
+	ohmd_probe_callback probe_callback;
+	void* probe_data;
+
+	// hotplug monitoring, the callback is guarded by update_mutex
+	ohmd_thread* hotplug_thread;
+	ohmd_dir_watch* hotplug_watch;
+	bool hotplug_request_quit;
+	ohmd_hotplug_callback hotplug_callback;
+	void* hotplug_data;
+
+	// unordered, closing a device moves the last one into its place
+	ohmd_device** active_devices;
 	int num_active_devices;
+	int num_allocated_active_devices;
 
 	ohmd_thread* update_thread;
-	ohmd_mutex* update_mutex;
+	ohmd_mutex* update_mutex; // guards active_devices membership
+
+	// bumped by ohmd_device_signal_data, the shared update thread waits on it
+	ohmd_cond* data_cond;
+	volatile unsigned int data_seq;
+
+	// bumped when devices are released while ohmd_close_device waits for that, the waiters are counted under update_mutex
+	ohmd_cond* release_cond;
+	volatile unsigned int release_seq;
+	int num_release_waiters;
 
 	bool update_request_quit;
 
@@ -120,17 +241,27 @@ struct ohmd_context {
 };
 
 // helper functions
+bool ohmd_grow_array(void** array, int* num_allocated, int min_size, size_t elem_size);
+ohmd_device_desc* ohmd_device_list_add(ohmd_device_list* list);
+void ohmd_add_driver(ohmd_context* ctx, ohmd_driver* driver);
+int ohmd_start_hotplug(ohmd_context* ctx, const char* path, const char* prefix, ohmd_hotplug_callback callback, void* user_data);
 void ohmd_set_default_device_properties(ohmd_device_properties* props);
 void ohmd_calc_default_proj_matrices(ohmd_device_properties* props);
+void ohmd_device_publish_pose(ohmd_device* device);
+void ohmd_device_read_pose(ohmd_device* device, ohmd_pose* out);
+void ohmd_device_push_sample(ohmd_device* device, double time, const quatf* orient, const vec3f* ang_vel);
+void ohmd_device_signal_data(ohmd_device* device);
 
 // drivers
 ohmd_driver* ohmd_create_dummy_drv(ohmd_context* ctx);
 ohmd_driver* ohmd_create_oculus_rift_drv(ohmd_context* ctx);
 ohmd_driver* ohmd_create_external_drv(ohmd_context* ctx);
 ohmd_driver* ohmd_create_android_drv(ohmd_context* ctx);
+ohmd_driver* ohmd_create_replay_drv(ohmd_context* ctx);
 
 #include "log.h"
 #include "omath.h"
 #include "fusion.h"
+#include "capture.h"
 
 #endif
@@ -13,16 +13,37 @@
 #define CLOCK_MONOTONIC (clockid_t)4
 #endif
 
-#define _POSIX_C_SOURCE 199309L
+#define _POSIX_C_SOURCE 200112L
+
+// for pthread_setaffinity_np
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 
 #include <time.h>
 #include <sys/time.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
 
 #include "platform.h"
 #include "openhmdi.h"
 
+// Conds time out on the clock of ohmd_get_tick, so changes to the wall clock don't
+// stretch or cut short waits. macOS can't set the clock of a cond.
+#if defined(CLOCK_MONOTONIC) && !defined(__APPLE__)
+#define COND_CLOCK CLOCK_MONOTONIC
+#endif
+
 // Use clock_gettime if the system implements posix realtime timers
 #ifndef CLOCK_MONOTONIC
 double ohmd_get_tick()
@@ -107,6 +128,27 @@ void ohmd_destroy_thread(ohmd_thread* thread)
 	free(thread);
 }
 
+bool ohmd_set_thread_affinity(ohmd_thread* thread, int cpu)
+{
+#ifdef __linux__
+	if(cpu < 0 || cpu >= CPU_SETSIZE)
+		return false;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	return pthread_setaffinity_np(thread->thread, sizeof(cpu_set_t), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+bool ohmd_is_current_thread(ohmd_thread* thread)
+{
+	return pthread_equal(pthread_self(), thread->thread) != 0;
+}
+
 void ohmd_destroy_mutex(ohmd_mutex* mutex)
 {
 	pthread_mutex_destroy((pthread_mutex_t*)mutex);
@@ -125,4 +167,213 @@ void ohmd_unlock_mutex(ohmd_mutex* mutex)
 		pthread_mutex_unlock((pthread_mutex_t*)mutex);
 }
 
+struct ohmd_cond
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+ohmd_cond* ohmd_create_cond(ohmd_context* ctx)
+{
+	ohmd_cond* cond = ohmd_alloc(ctx, sizeof(ohmd_cond));
+	if(cond == NULL)
+		return NULL;
+
+	if(pthread_mutex_init(&cond->mutex, NULL) != 0){
+		free(cond);
+		return NULL;
+	}
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+#ifdef COND_CLOCK
+	pthread_condattr_setclock(&attr, COND_CLOCK);
+#endif
+
+	int ret = pthread_cond_init(&cond->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if(ret != 0){
+		pthread_mutex_destroy(&cond->mutex);
+		free(cond);
+		return NULL;
+	}
+
+	return cond;
+}
+
+void ohmd_destroy_cond(ohmd_cond* cond)
+{
+	pthread_cond_destroy(&cond->cond);
+	pthread_mutex_destroy(&cond->mutex);
+	free(cond);
+}
+
+void ohmd_signal_cond(ohmd_cond* cond)
+{
+	if(cond){
+		// taking the mutex orders the wake up after a waiter has checked the value
+		pthread_mutex_lock(&cond->mutex);
+		pthread_cond_broadcast(&cond->cond);
+		pthread_mutex_unlock(&cond->mutex);
+	}
+}
+
+bool ohmd_wait_cond(ohmd_cond* cond, volatile unsigned int* value, unsigned int old_value, double timeout)
+{
+	// pthread_cond_timedwait takes an absolute time on the clock of the cond
+	struct timespec deadline;
+
+#ifdef COND_CLOCK
+	struct timespec now;
+	clock_gettime(COND_CLOCK, &now);
+	double end = (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0 + timeout;
+#else
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	double end = (double)now.tv_sec + (double)now.tv_usec / 1000000.0 + timeout;
+#endif
+	deadline.tv_sec = (time_t)end;
+	deadline.tv_nsec = OHMD_MIN((long)((end - deadline.tv_sec) * 1000000000.0), 999999999L);
+
+	pthread_mutex_lock(&cond->mutex);
+
+	int ret = 0;
+	while(*value == old_value && ret == 0)
+		ret = pthread_cond_timedwait(&cond->cond, &cond->mutex, &deadline);
+
+	bool changed = *value != old_value;
+
+	pthread_mutex_unlock(&cond->mutex);
+
+	return changed;
+}
+
+struct ohmd_dir_watch
+{
+	int fd;
+	char prefix[OHMD_STR_SIZE];
+
+#ifdef __linux__
+	// events read but not returned yet, from pos to len
+	union {
+		struct inotify_event event;
+		char buf[4096];
+	} events;
+	size_t pos, len;
+#endif
+};
+
+ohmd_dir_watch* ohmd_create_dir_watch(ohmd_context* ctx, const char* path, const char* prefix)
+{
+#ifdef __linux__
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(fd < 0){
+		ohmd_set_error(ctx, "could not create inotify instance");
+		return NULL;
+	}
+
+	if(inotify_add_watch(fd, path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0){
+		close(fd);
+		ohmd_set_error(ctx, "could not watch %s", path);
+		return NULL;
+	}
+
+	ohmd_dir_watch* watch = ohmd_alloc(ctx, sizeof(ohmd_dir_watch));
+	if(watch == NULL){
+		close(fd);
+		return NULL;
+	}
+
+	watch->fd = fd;
+	strncpy(watch->prefix, prefix, OHMD_STR_SIZE - 1);
+
+	return watch;
+#else
+	ohmd_set_error(ctx, "watching directories is not supported on this platform");
+	return NULL;
+#endif
+}
+
+void ohmd_destroy_dir_watch(ohmd_dir_watch* watch)
+{
+#ifdef __linux__
+	close(watch->fd);
+#endif
+	free(watch);
+}
+
+#ifdef __linux__
+// takes the next buffered event of a matching entry, returns false if there is none
+static bool next_dir_change(ohmd_dir_watch* watch, ohmd_dir_change* change)
+{
+	size_t prefix_len = strlen(watch->prefix);
+
+	while(watch->pos < watch->len){
+		struct inotify_event* event = (struct inotify_event*)(watch->events.buf + watch->pos);
+		watch->pos += sizeof(struct inotify_event) + event->len;
+
+		if(event->len > 0 && strncmp(event->name, watch->prefix, prefix_len) == 0){
+			change->removed = (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+			snprintf(change->name, OHMD_STR_SIZE, "%s", event->name);
+			return true;
+		}
+	}
+
+	return false;
+}
+#endif
+
+bool ohmd_wait_dir_watch(ohmd_dir_watch* watch, double timeout, ohmd_dir_change* change)
+{
+#ifdef __linux__
+	if(next_dir_change(watch, change))
+		return true;
+
+	struct pollfd pfd = { watch->fd, POLLIN, 0 };
+
+	if(poll(&pfd, 1, (int)(timeout * 1000)) <= 0)
+		return false;
+
+	ssize_t len;
+
+	while((len = read(watch->fd, watch->events.buf, sizeof(watch->events.buf))) > 0){
+		watch->pos = 0;
+		watch->len = len;
+
+		if(next_dir_change(watch, change))
+			return true;
+	}
+
+	watch->pos = watch->len = 0;
+
+	return false;
+#else
+	ohmd_sleep(timeout);
+	return false;
+#endif
+}
+
+FILE* ohmd_create_new_file(const char* path, bool* exists)
+{
+	*exists = false;
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if(fd < 0){
+		*exists = errno == EEXIST;
+		return NULL;
+	}
+
+	FILE* file = fdopen(fd, "wb");
+	if(!file)
+		close(fd);
+
+	return file;
+}
+
+void ohmd_memory_barrier()
+{
+	__sync_synchronize();
+}
+
 #endif
@@ -13,6 +13,10 @@
 #define WIN32_EXTRA_LEAN
 
 #include <windows.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
 
 #include "platform.h"
 #include "openhmdi.h"
@@ -70,12 +74,25 @@ ohmd_thread* ohmd_create_thread(ohmd_context* ctx, unsigned int (*routine)(void*
 
 void ohmd_destroy_thread(ohmd_thread* thread)
 {
-	ohmd_sleep(3);
 	WaitForSingleObject(thread->handle, INFINITE);
 	CloseHandle(thread->handle);
 	free(thread);
 }
 
+bool ohmd_set_thread_affinity(ohmd_thread* thread, int cpu)
+{
+	// the mask only covers the processors of the thread's group
+	if(cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8))
+		return false;
+
+	return SetThreadAffinityMask(thread->handle, (DWORD_PTR)1 << cpu) != 0;
+}
+
+bool ohmd_is_current_thread(ohmd_thread* thread)
+{
+	return GetThreadId(thread->handle) == GetCurrentThreadId();
+}
+
 ohmd_mutex* ohmd_create_mutex(ohmd_context* ctx)
 {
 	ohmd_mutex* mutex = ohmd_alloc(ctx, sizeof(ohmd_mutex));
@@ -105,4 +122,97 @@ void ohmd_unlock_mutex(ohmd_mutex* mutex)
 		ReleaseMutex(mutex->handle);
 }
 
+struct ohmd_cond {
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE cond;
+};
+
+ohmd_cond* ohmd_create_cond(ohmd_context* ctx)
+{
+	ohmd_cond* cond = ohmd_alloc(ctx, sizeof(ohmd_cond));
+	if(!cond)
+		return NULL;
+
+	InitializeCriticalSection(&cond->lock);
+	InitializeConditionVariable(&cond->cond);
+
+	return cond;
+}
+
+void ohmd_destroy_cond(ohmd_cond* cond)
+{
+	DeleteCriticalSection(&cond->lock);
+	free(cond);
+}
+
+void ohmd_signal_cond(ohmd_cond* cond)
+{
+	if(cond){
+		EnterCriticalSection(&cond->lock);
+		WakeAllConditionVariable(&cond->cond);
+		LeaveCriticalSection(&cond->lock);
+	}
+}
+
+bool ohmd_wait_cond(ohmd_cond* cond, volatile unsigned int* value, unsigned int old_value, double timeout)
+{
+	double deadline = ohmd_get_tick() + timeout;
+
+	EnterCriticalSection(&cond->lock);
+
+	while(*value == old_value){
+		double left = deadline - ohmd_get_tick();
+		if(left <= 0)
+			break;
+
+		SleepConditionVariableCS(&cond->cond, &cond->lock, (DWORD)(left * 1000) + 1);
+	}
+
+	bool changed = *value != old_value;
+
+	LeaveCriticalSection(&cond->lock);
+
+	return changed;
+}
+
+// HID devices don't show up as files on Windows, so there is no directory to watch
+
+ohmd_dir_watch* ohmd_create_dir_watch(ohmd_context* ctx, const char* path, const char* prefix)
+{
+	ohmd_set_error(ctx, "watching directories is not supported on this platform");
+	return NULL;
+}
+
+void ohmd_destroy_dir_watch(ohmd_dir_watch* watch)
+{
+}
+
+bool ohmd_wait_dir_watch(ohmd_dir_watch* watch, double timeout, ohmd_dir_change* change)
+{
+	ohmd_sleep(timeout);
+	return false;
+}
+
+FILE* ohmd_create_new_file(const char* path, bool* exists)
+{
+	*exists = false;
+
+	int fd = _open(path, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+	if(fd < 0){
+		*exists = errno == EEXIST;
+		return NULL;
+	}
+
+	FILE* file = _fdopen(fd, "wb");
+	if(!file)
+		_close(fd);
+
+	return file;
+}
+
+void ohmd_memory_barrier()
+{
+	MemoryBarrier();
+}
+
 #endif
@@ -12,11 +12,22 @@
 
 #include "openhmd.h"
 
+#include <stdbool.h>
+#include <stdio.h>
+
 double ohmd_get_tick();
 void ohmd_sleep(double seconds);
 
 typedef struct ohmd_thread ohmd_thread;
 typedef struct ohmd_mutex ohmd_mutex;
+typedef struct ohmd_cond ohmd_cond;
+typedef struct ohmd_dir_watch ohmd_dir_watch;
+
+// an entry of a watched directory that was added or removed
+typedef struct {
+	bool removed;
+	char name[OHMD_STR_SIZE];
+} ohmd_dir_change;
 
 ohmd_mutex* ohmd_create_mutex(ohmd_context* ctx);
 void ohmd_destroy_mutex(ohmd_mutex* mutex);
@@ -26,6 +37,33 @@ void ohmd_unlock_mutex(ohmd_mutex* mutex);
 
 ohmd_thread* ohmd_create_thread(ohmd_context* ctx, unsigned int (*routine)(void* arg), void* arg);
 void ohmd_destroy_thread(ohmd_thread* thread);
+// false if cpu is out of range or threads can't be pinned on this platform
+bool ohmd_set_thread_affinity(ohmd_thread* thread, int cpu);
+// true if called from thread itself
+bool ohmd_is_current_thread(ohmd_thread* thread);
+
+ohmd_cond* ohmd_create_cond(ohmd_context* ctx);
+void ohmd_destroy_cond(ohmd_cond* cond);
+
+// wake every thread waiting on cond, call after changing the value they wait on
+void ohmd_signal_cond(ohmd_cond* cond);
+// block until *value differs from old_value or timeout seconds have passed, returns true if it changed
+bool ohmd_wait_cond(ohmd_cond* cond, volatile unsigned int* value, unsigned int old_value, double timeout);
+
+// watch a directory for entries whose name starts with prefix being added or removed,
+// returns NULL if that can't be done on this platform
+ohmd_dir_watch* ohmd_create_dir_watch(ohmd_context* ctx, const char* path, const char* prefix);
+void ohmd_destroy_dir_watch(ohmd_dir_watch* watch);
+// block for up to timeout seconds until a matching entry changed, returns true and fills in change if one did,
+// changes that came in together are returned one per call
+bool ohmd_wait_dir_watch(ohmd_dir_watch* watch, double timeout, ohmd_dir_change* change);
+
+// create path for writing, failing if it already exists rather than truncating it,
+// exists is set if that's why NULL was returned
+FILE* ohmd_create_new_file(const char* path, bool* exists);
+
+// full memory barrier, orders loads and stores on both sides of the call
+void ohmd_memory_barrier();
 
 
 #endif
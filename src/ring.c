@@ -0,0 +1,119 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Report Ring - Lock Free Single Producer, Single Consumer Queue */
+
+#include "openhmdi.h"
+
+struct ohmd_ring {
+	unsigned char* items;
+	int item_size;
+	unsigned int num_items;
+
+	// only the producer moves head and only the consumer moves tail,
+	// both count up forever and wrap around together
+	volatile unsigned int head, tail;
+	volatile unsigned int overruns;
+
+	ohmd_cond* cond; // signalled when head moves
+};
+
+ohmd_ring* ohmd_create_ring(ohmd_context* ctx, int item_size, int num_items)
+{
+	if(num_items <= 0 || (num_items & (num_items - 1)) != 0){
+		ohmd_set_error(ctx, "ring size must be a power of two (%d)", num_items);
+		return NULL;
+	}
+
+	ohmd_ring* ring = ohmd_alloc(ctx, sizeof(ohmd_ring));
+	if(!ring)
+		return NULL;
+
+	ring->items = ohmd_alloc(ctx, (size_t)item_size * num_items);
+	ring->cond = ohmd_create_cond(ctx);
+	if(!ring->items || !ring->cond){
+		if(ring->cond)
+			ohmd_destroy_cond(ring->cond);
+		free(ring->items);
+		free(ring);
+		return NULL;
+	}
+
+	ring->item_size = item_size;
+	ring->num_items = (unsigned int)num_items;
+
+	return ring;
+}
+
+void ohmd_destroy_ring(ohmd_ring* ring)
+{
+	ohmd_destroy_cond(ring->cond);
+	free(ring->items);
+	free(ring);
+}
+
+static void* get_slot(ohmd_ring* ring, unsigned int index)
+{
+	return ring->items + (size_t)(index & (ring->num_items - 1)) * ring->item_size;
+}
+
+void* ohmd_ring_begin_push(ohmd_ring* ring)
+{
+	unsigned int head = ring->head;
+	if(head - ring->tail == ring->num_items){
+		// the consumer fell behind, drop the item rather than stall the producer
+		ring->overruns++;
+		return NULL;
+	}
+
+	return get_slot(ring, head);
+}
+
+void ohmd_ring_end_push(ohmd_ring* ring)
+{
+	// publish the item only once it's completely written
+	ohmd_memory_barrier();
+	ring->head++;
+	ohmd_signal_cond(ring->cond);
+}
+
+void* ohmd_ring_peek(ohmd_ring* ring)
+{
+	unsigned int tail = ring->tail;
+	if(ring->head == tail)
+		return NULL;
+
+	// read the item only after seeing head move past it
+	ohmd_memory_barrier();
+	return get_slot(ring, tail);
+}
+
+void ohmd_ring_pop(ohmd_ring* ring)
+{
+	// hand the slot back only once it's been read
+	ohmd_memory_barrier();
+	ring->tail++;
+}
+
+bool ohmd_ring_wait(ohmd_ring* ring, double timeout)
+{
+	unsigned int tail = ring->tail;
+	if(ring->head != tail)
+		return true;
+
+	return ohmd_wait_cond(ring->cond, &ring->head, tail, timeout);
+}
+
+int ohmd_ring_get_depth(ohmd_ring* ring)
+{
+	return (int)(ring->head - ring->tail);
+}
+
+unsigned int ohmd_ring_get_overruns(ohmd_ring* ring)
+{
+	return ring->overruns;
+}
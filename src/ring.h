@@ -0,0 +1,42 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Report Ring - Lock Free Single Producer, Single Consumer Queue */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+
+#include "openhmd.h"
+
+// Hands fixed size items, such as sensor reports, from a reader thread to the
+// update thread. Only one thread may push and only one other thread may pop.
+// A full ring drops new items rather than blocking the producer.
+typedef struct ohmd_ring ohmd_ring;
+
+// num_items must be a power of two
+ohmd_ring* ohmd_create_ring(ohmd_context* ctx, int item_size, int num_items);
+void ohmd_destroy_ring(ohmd_ring* ring);
+
+// producer: returns the slot to write the next item to, or NULL and counts an
+// overrun if the ring is full. The item is only queued by ohmd_ring_end_push,
+// so a slot can be given up by not calling it.
+void* ohmd_ring_begin_push(ohmd_ring* ring);
+void ohmd_ring_end_push(ohmd_ring* ring);
+
+// consumer: returns the oldest item, or NULL if the ring is empty. The item
+// stays valid until ohmd_ring_pop.
+void* ohmd_ring_peek(ohmd_ring* ring);
+void ohmd_ring_pop(ohmd_ring* ring);
+// waits up to timeout seconds for the ring to be non-empty, returns true if it is
+bool ohmd_ring_wait(ohmd_ring* ring, double timeout);
+
+int ohmd_ring_get_depth(ohmd_ring* ring);
+unsigned int ohmd_ring_get_overruns(ohmd_ring* ring);
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Benchmarks - Rotation Prediction Error Against Horizon, From a Replayed Capture */
+
+// usage: predictbench [--fast] [capture file]
+//
+// Replays a Rift capture one report at a time. After every report the rotation is predicted
+// at several horizons past the newest sample with ohmd_device_get_pose_at, and once the
+// replay has passed that time the prediction is compared to the rotation fused from the
+// samples actually taken then. Holding the newest rotation is measured the same way, as the
+// error without prediction. Without a capture file, a synthetic one of a head turning from
+// side to side is written and replayed.
+//
+// With --fast the capture is replayed in the replay driver's fast mode instead, all reports on
+// one update, and the number of samples decoded and fused per second is printed.
+
+// for setenv
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "openhmdi.h"
+#include "drv_oculus_rift/rift.h"
+
+#define SYNTHETIC_FILE "predictbench.capture"
+#define SYNTHETIC_SECONDS 10.0
+#define SYNTHETIC_RATE 1000.0
+
+#define NUM_HORIZONS 7
+static const double horizons[NUM_HORIZONS] = { 0.005, 0.010, 0.015, 0.020, 0.030, 0.050, 0.100 };
+
+// predictions waiting for the replay to reach their time, per horizon
+#define MAX_PENDING 1024
+
+typedef struct {
+	double time;
+	quatf predicted, held;
+} prediction;
+
+typedef struct {
+	prediction pending[MAX_PENDING];
+	unsigned int head, tail;
+
+	double predicted_sum, predicted_max;
+	double held_sum, held_max;
+	int count;
+} horizon_stats;
+
+static horizon_stats stats[NUM_HORIZONS];
+
+// the yaw rate in rad/s at time t, of a slow turn from side to side with faster, smaller movements on top
+static double synthetic_yaw_rate(double t)
+{
+	return 0.8 * 2 * M_PI * 0.25 * cos(2 * M_PI * 0.25 * t) +
+	       0.2 * 2 * M_PI * 1.3 * cos(2 * M_PI * 1.3 * t + 1.0) +
+	       0.05 * 2 * M_PI * 4.1 * cos(2 * M_PI * 4.1 * t);
+}
+
+static bool write_synthetic_capture(ohmd_context* ctx)
+{
+	ohmd_capture* capture = ohmd_create_capture(ctx, SYNTHETIC_FILE, 0);
+	if(!capture)
+		return false;
+
+	int num_reports = (int)(SYNTHETIC_SECONDS * SYNTHETIC_RATE);
+	unsigned char report[62];
+	pkt_tracker_sensor msg = { 1 };
+	vec3f accel = {{ 0, 9.81f, 0 }}, gyro = {{ 0, 0, 0 }};
+	srand(1);
+
+	rift_vec_from_vec3f(&accel, msg.samples[0].accel);
+
+	for(int i = 0; i < num_reports; i++){
+		double t = i / SYNTHETIC_RATE;
+
+		// a little gyro noise, about what a DK1 has at rest
+		float noise = ((float)rand() / RAND_MAX - 0.5f) * 0.01f;
+
+		gyro.y = (float)synthetic_yaw_rate(t) + noise;
+		rift_vec_from_vec3f(&gyro, msg.samples[0].gyro);
+		msg.timestamp = i;
+
+		int size = encode_tracker_sensor_msg(report, &msg);
+		ohmd_capture_write(capture, OHMD_CAPTURE_INPUT_REPORT, t, report, size);
+	}
+
+	ohmd_destroy_capture(capture);
+	return true;
+}
+
+static void set_env(const char* name, const char* value)
+{
+#ifdef _WIN32
+	_putenv_s(name, value);
+#else
+	setenv(name, value, 1);
+#endif
+}
+
+static double angle_between(const quatf* a, const quatf* b)
+{
+	float dot = fabsf(a->x * b->x + a->y * b->y + a->z * b->z + a->w * b->w);
+	return 2.0 * acos(OHMD_MIN(dot, 1.0f));
+}
+
+static void evaluate_due(ohmd_device* dev, horizon_stats* s, double sample_time)
+{
+	while(s->tail != s->head && s->pending[s->tail % MAX_PENDING].time <= sample_time){
+		prediction* p = &s->pending[s->tail % MAX_PENDING];
+
+		// what was fused from the samples around that time
+		quatf actual;
+		if(ohmd_device_get_pose_at(dev, p->time, actual.arr) == 0){
+			double predicted_error = angle_between(&p->predicted, &actual);
+			double held_error = angle_between(&p->held, &actual);
+
+			s->predicted_sum += predicted_error;
+			s->predicted_max = OHMD_MAX(s->predicted_max, predicted_error);
+			s->held_sum += held_error;
+			s->held_max = OHMD_MAX(s->held_max, held_error);
+			s->count++;
+		}
+
+		s->tail++;
+	}
+}
+
+// opens the replay device of path in the given replay mode, updated only by ohmd_ctx_update
+static ohmd_device* open_replay(ohmd_context** out_ctx, const char* path, const char* mode)
+{
+	set_env("OPENHMD_REPLAY_FILE", path);
+	set_env("OPENHMD_REPLAY_MODE", mode);
+
+	ohmd_ctx_settings* ctx_settings = ohmd_ctx_settings_create();
+	int drivers = OHMD_DRV_REPLAY;
+	ohmd_ctx_settings_seti(ctx_settings, OHMD_ICS_DRIVERS, &drivers);
+
+	ohmd_context* ctx = ohmd_ctx_create_ex(ctx_settings);
+	ohmd_ctx_settings_destroy(ctx_settings);
+	*out_ctx = ctx;
+
+	if(!ctx || ohmd_ctx_probe(ctx) < 1){
+		printf("failed to list the replay device\n");
+		return NULL;
+	}
+
+	ohmd_device_settings* settings = ohmd_device_settings_create(ctx);
+	int auto_update = 0;
+	ohmd_device_settings_seti(settings, OHMD_IDS_AUTOMATIC_UPDATE, &auto_update);
+
+	ohmd_device* dev = ohmd_list_open_device_s(ctx, 0, settings);
+	ohmd_device_settings_destroy(settings);
+	if(!dev)
+		printf("failed to replay %s: %s\n", path, ohmd_ctx_get_error(ctx));
+
+	return dev;
+}
+
+static int run_fast(const char* path)
+{
+	ohmd_context* ctx;
+	ohmd_device* dev = open_replay(&ctx, path, "fast");
+	if(!dev)
+		return 1;
+
+	// the first update replays everything
+	double start = ohmd_get_tick();
+	ohmd_ctx_update(ctx);
+	double elapsed = ohmd_get_tick() - start;
+
+	unsigned int num_samples;
+	ohmd_device_wait_for_sample(dev, 0, 0, &num_samples);
+
+	ohmd_ctx_destroy(ctx);
+
+	printf("%u samples fused from %s in %.3f ms\n", num_samples, path, elapsed * 1000.0);
+	printf("%.0f samples per second\n", elapsed > 0 ? num_samples / elapsed : 0);
+
+	return 0;
+}
+
+static int run_predict(const char* path)
+{
+	ohmd_context* ctx;
+
+	// one report per update, so the replay can be stopped after every one of them
+	ohmd_device* dev = open_replay(&ctx, path, "paced");
+	if(!dev)
+		return 1;
+
+	unsigned int last_sample = 0;
+	int num_reports = 0;
+
+	while(true){
+		ohmd_ctx_update(ctx);
+
+		unsigned int sample;
+		ohmd_device_wait_for_sample(dev, last_sample, 0, &sample);
+		if(sample == last_sample)
+			break;
+
+		last_sample = sample;
+		num_reports++;
+
+		double time;
+		ohmd_device_get_sample_time(dev, &time);
+
+		quatf held;
+		ohmd_device_get_pose_at(dev, time, held.arr);
+
+		for(int i = 0; i < NUM_HORIZONS; i++){
+			horizon_stats* s = &stats[i];
+			evaluate_due(dev, s, time);
+
+			if(s->head - s->tail == MAX_PENDING)
+				continue;
+
+			prediction* p = &s->pending[s->head % MAX_PENDING];
+			p->time = time + horizons[i];
+			p->held = held;
+			ohmd_device_get_pose_at(dev, p->time, p->predicted.arr);
+			s->head++;
+		}
+	}
+
+	ohmd_ctx_destroy(ctx);
+
+	printf("%d reports replayed from %s\n", num_reports, path);
+	printf("horizon    predicted error (mean, max)    held error (mean, max), in degrees\n");
+
+	for(int i = 0; i < NUM_HORIZONS; i++){
+		horizon_stats* s = &stats[i];
+		if(s->count == 0)
+			continue;
+
+		printf("%4.0f ms    %6.3f  %6.3f                   %6.3f  %6.3f\n", horizons[i] * 1000.0,
+			RAD_TO_DEG(s->predicted_sum / s->count), RAD_TO_DEG(s->predicted_max),
+			RAD_TO_DEG(s->held_sum / s->count), RAD_TO_DEG(s->held_max));
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	bool fast = argc > 1 && strcmp(argv[1], "--fast") == 0;
+	if(fast){
+		argc--;
+		argv++;
+	}
+
+	const char* path = argc > 1 ? argv[1] : SYNTHETIC_FILE;
+
+	ohmd_context* ctx = ohmd_ctx_create();
+	if(!ctx){
+		printf("failed to create context\n");
+		return 1;
+	}
+
+	if(argc <= 1 && !write_synthetic_capture(ctx)){
+		printf("failed to write %s: %s\n", SYNTHETIC_FILE, ohmd_ctx_get_error(ctx));
+		return 1;
+	}
+
+	ohmd_ctx_destroy(ctx);
+
+	int ret = fast ? run_fast(path) : run_predict(path);
+
+	if(argc <= 1)
+		remove(SYNTHETIC_FILE);
+
+	return ret;
+}
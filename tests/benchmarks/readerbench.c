@@ -0,0 +1,189 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Benchmarks - Pose Reader Latency Under Contention, Against the Mock HIDAPI */
+
+// usage: readerbench [reader threads] [seconds] [update rate in Hz]
+//
+// Reader threads call ohmd_device_getf for the rotation of a Rift as fast as they can, while
+// its dedicated update thread fuses reports at the update rate. The latency of every call is
+// measured, first with the update thread running and then, as a baseline, without it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mock_hidapi.h"
+
+#define MAX_READERS 16
+// latencies are counted in buckets this wide, in seconds, anything slower goes in the last bucket
+#define BUCKET_WIDTH 10e-9
+#define NUM_BUCKETS 100000
+
+typedef struct {
+	ohmd_device* dev;
+	double seconds;
+
+	unsigned int* buckets;
+	unsigned long long num_calls;
+	double sum, max;
+} reader;
+
+static unsigned int reader_thread(void* arg)
+{
+	reader* r = (reader*)arg;
+	quatf rot;
+
+	double end = ohmd_get_tick() + r->seconds;
+
+	for(double now = ohmd_get_tick(); now < end; ){
+		ohmd_device_getf(r->dev, OHMD_ROTATION_QUAT, rot.arr);
+		double after = ohmd_get_tick();
+		double latency = after - now;
+
+		r->buckets[OHMD_MIN((int)(latency / BUCKET_WIDTH), NUM_BUCKETS - 1)]++;
+		r->num_calls++;
+		r->sum += latency;
+		r->max = OHMD_MAX(r->max, latency);
+
+		now = after;
+	}
+
+	return 0;
+}
+
+// the latency below which the fraction p of all calls of all readers fall
+static double percentile(const reader* readers, int num_readers, unsigned long long count, double p)
+{
+	unsigned long long seen = 0;
+
+	for(int b = 0; b < NUM_BUCKETS; b++){
+		for(int i = 0; i < num_readers; i++)
+			seen += readers[i].buckets[b];
+
+		if(seen >= count * p)
+			return (b + 1) * BUCKET_WIDTH;
+	}
+
+	return NUM_BUCKETS * BUCKET_WIDTH;
+}
+
+static void run_readers(ohmd_context* ctx, ohmd_device* dev, reader* readers, int num_readers, double seconds, const char* name)
+{
+	ohmd_thread* threads[MAX_READERS];
+
+	for(int i = 0; i < num_readers; i++){
+		memset(readers[i].buckets, 0, sizeof(unsigned int) * NUM_BUCKETS);
+		readers[i].dev = dev;
+		readers[i].seconds = seconds;
+		readers[i].num_calls = 0;
+		readers[i].sum = readers[i].max = 0;
+		threads[i] = ohmd_create_thread(ctx, reader_thread, &readers[i]);
+	}
+
+	for(int i = 0; i < num_readers; i++)
+		ohmd_destroy_thread(threads[i]);
+
+	// all calls of all readers together
+	unsigned long long count = 0;
+	double sum = 0, max = 0;
+
+	for(int i = 0; i < num_readers; i++){
+		count += readers[i].num_calls;
+		sum += readers[i].sum;
+		max = OHMD_MAX(max, readers[i].max);
+	}
+
+	printf("%s:\n", name);
+	printf("  calls:    %llu, %.0f per second per reader\n", count, count / seconds / num_readers);
+	printf("  latency:  %.0f ns mean, %.0f ns median, %.0f ns p99, %.0f ns p99.9, %.0f ns max\n",
+		sum / count * 1e9, percentile(readers, num_readers, count, 0.5) * 1e9,
+		percentile(readers, num_readers, count, 0.99) * 1e9,
+		percentile(readers, num_readers, count, 0.999) * 1e9, max * 1e9);
+}
+
+int main(int argc, char** argv)
+{
+	int num_readers = argc > 1 ? atoi(argv[1]) : 1;
+	double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+	int update_rate = argc > 3 ? atoi(argv[3]) : 1000;
+
+	if(num_readers < 1 || num_readers > MAX_READERS){
+		printf("between 1 and %d reader threads\n", MAX_READERS);
+		return 1;
+	}
+
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.angular_velocity.y = 1.0f;
+	ohmd_mock_hid_set_config(&config);
+
+	ohmd_ctx_settings* ctx_settings = ohmd_ctx_settings_create();
+	int drivers = OHMD_DRV_OCULUS_RIFT;
+	ohmd_ctx_settings_seti(ctx_settings, OHMD_ICS_DRIVERS, &drivers);
+
+	ohmd_context* ctx = ohmd_ctx_create_ex(ctx_settings);
+	ohmd_ctx_settings_destroy(ctx_settings);
+	if(!ctx || ohmd_ctx_probe(ctx) < 1){
+		printf("failed to probe the mock Rift\n");
+		return 1;
+	}
+
+	// a thread of its own updating the device at a fixed rate
+	ohmd_device_settings* settings = ohmd_device_settings_create(ctx);
+	int update_mode = OHMD_UPDATE_MODE_DEDICATED;
+	ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_MODE, &update_mode);
+	ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_RATE, &update_rate);
+
+	ohmd_device* dev = ohmd_list_open_device_s(ctx, 0, settings);
+	ohmd_device_settings_destroy(settings);
+	if(!dev){
+		printf("failed to open the mock Rift: %s\n", ohmd_ctx_get_error(ctx));
+		return 1;
+	}
+
+	reader readers[MAX_READERS];
+	for(int i = 0; i < num_readers; i++){
+		readers[i].buckets = malloc(sizeof(unsigned int) * NUM_BUCKETS);
+		if(!readers[i].buckets){
+			printf("out of memory\n");
+			return 1;
+		}
+	}
+
+	printf("%d reader threads, update thread at %d Hz\n", num_readers, update_rate);
+
+	unsigned int first_sample, last_sample;
+	ohmd_device_wait_for_sample(dev, 0, 1.0, &first_sample);
+
+	run_readers(ctx, dev, readers, num_readers, seconds, "update thread running");
+
+	ohmd_device_wait_for_sample(dev, 0, 0, &last_sample);
+	printf("  samples fused meanwhile: %u\n", last_sample - first_sample);
+
+	// reopened without any update thread
+	ohmd_close_device(dev);
+
+	settings = ohmd_device_settings_create(ctx);
+	int auto_update = 0;
+	ohmd_device_settings_seti(settings, OHMD_IDS_AUTOMATIC_UPDATE, &auto_update);
+
+	dev = ohmd_list_open_device_s(ctx, 0, settings);
+	ohmd_device_settings_destroy(settings);
+	if(!dev){
+		printf("failed to reopen the mock Rift: %s\n", ohmd_ctx_get_error(ctx));
+		return 1;
+	}
+
+	run_readers(ctx, dev, readers, num_readers, seconds, "no update thread");
+
+	for(int i = 0; i < num_readers; i++)
+		free(readers[i].buckets);
+
+	ohmd_ctx_destroy(ctx);
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Benchmarks - Oculus Rift Driver Throughput, Against the Mock HIDAPI */
+
+// usage: riftbench [devices] [reports per second] [seconds] [jitter in ms] [drop rate] [shared|dedicated]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mock_hidapi.h"
+
+#define MAX_DEVICES 64
+// how often the age of the poses is sampled, in seconds
+#define POLL_INTERVAL 0.01
+
+int main(int argc, char** argv)
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+
+	config.num_devices = argc > 1 ? atoi(argv[1]) : 4;
+	config.report_rate = argc > 2 ? atof(argv[2]) : 1000.0;
+	double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+	config.jitter = argc > 4 ? atof(argv[4]) / 1000.0 : 0;
+	config.drop_rate = argc > 5 ? atof(argv[5]) : 0;
+	int update_mode = argc > 6 && strcmp(argv[6], "dedicated") == 0 ? OHMD_UPDATE_MODE_DEDICATED : OHMD_UPDATE_MODE_SHARED;
+	config.angular_velocity.y = 1.0f;
+
+	if(config.num_devices < 1 || config.num_devices > MAX_DEVICES){
+		printf("between 1 and %d devices\n", MAX_DEVICES);
+		return 1;
+	}
+
+	ohmd_mock_hid_set_config(&config);
+
+	ohmd_ctx_settings* ctx_settings = ohmd_ctx_settings_create();
+	int drivers = OHMD_DRV_OCULUS_RIFT;
+	ohmd_ctx_settings_seti(ctx_settings, OHMD_ICS_DRIVERS, &drivers);
+
+	ohmd_context* ctx = ohmd_ctx_create_ex(ctx_settings);
+	ohmd_ctx_settings_destroy(ctx_settings);
+	if(!ctx){
+		printf("failed to create context\n");
+		return 1;
+	}
+
+	int num_devices = ohmd_ctx_probe(ctx);
+
+	ohmd_device_settings* settings = ohmd_device_settings_create(ctx);
+	ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_MODE, &update_mode);
+
+	int indices[MAX_DEVICES];
+	ohmd_device* devs[MAX_DEVICES];
+	for(int i = 0; i < num_devices; i++)
+		indices[i] = i;
+
+	double start = ohmd_get_tick();
+	int num_open = ohmd_list_open_devices(ctx, num_devices, indices, settings, devs);
+	double open_time = ohmd_get_tick() - start;
+
+	ohmd_device_settings_destroy(settings);
+
+	if(num_open != num_devices){
+		printf("failed to open devices: %s\n", ohmd_ctx_get_error(ctx));
+		return 1;
+	}
+
+	printf("%d devices at %.0f Hz, %.1f ms jitter, %.1f%% dropped, %s updates\n",
+		num_devices, config.report_rate, config.jitter * 1000.0, config.drop_rate * 100.0,
+		update_mode == OHMD_UPDATE_MODE_DEDICATED ? "dedicated" : "shared");
+	printf("opened in %.1f ms\n", open_time * 1000.0);
+
+	// the age of the newest sample of every device, sampled as an application would
+	double age_sum = 0, age_max = 0;
+	int age_count = 0;
+
+	start = ohmd_get_tick();
+	clock_t cpu_start = clock();
+
+	while(ohmd_get_tick() - start < seconds){
+		ohmd_sleep(POLL_INTERVAL);
+
+		for(int i = 0; i < num_devices; i++){
+			double time;
+			if(ohmd_device_get_sample_time(devs[i], &time) != 0 || time == 0)
+				continue;
+
+			double age = ohmd_get_tick() - time;
+			age_sum += age;
+			age_max = OHMD_MAX(age_max, age);
+			age_count++;
+		}
+	}
+
+	double elapsed = ohmd_get_tick() - start;
+	double cpu = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+
+	int total_samples = 0, total_overruns = 0, total_dropped = 0, total_late = 0;
+	for(int i = 0; i < num_devices; i++){
+		int samples = 0, overruns = 0, dropped = 0, late = 0;
+		ohmd_device_geti(devs[i], OHMD_SAMPLE_NUMBER, &samples);
+		ohmd_device_geti(devs[i], OHMD_SENSOR_QUEUE_OVERRUNS, &overruns);
+		ohmd_device_geti(devs[i], OHMD_DROPPED_SAMPLES, &dropped);
+		ohmd_device_geti(devs[i], OHMD_LATE_SAMPLES, &late);
+		total_samples += samples;
+		total_overruns += overruns;
+		total_dropped += dropped;
+		total_late += late;
+	}
+
+	ohmd_mock_hid_stats stats;
+	ohmd_mock_hid_get_stats(&stats);
+
+	printf("reports delivered:  %u (%u dropped, %u overflowed)\n",
+		stats.input_reports, stats.dropped_reports, stats.overflowed_reports);
+	printf("samples fused:      %d, %.0f per second\n", total_samples, total_samples / elapsed);
+	printf("queue overruns:     %d\n", total_overruns);
+	printf("samples missed:     %d dropped, %d late\n", total_dropped, total_late);
+	printf("pose age:           %.2f ms mean, %.2f ms max\n",
+		age_count ? age_sum / age_count * 1000.0 : 0, age_max * 1000.0);
+	// the mock hands out reports from the reader threads, so it's counted as well
+	printf("cpu time:           %.1f%% of one core\n", cpu / elapsed * 100.0);
+
+	ohmd_ctx_destroy(ctx);
+	return 0;
+}
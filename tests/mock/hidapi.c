@@ -0,0 +1,445 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Mock HIDAPI - Emulated Rift DK1s */
+
+// Linked in place of hidapi so the Rift driver can be exercised without
+// hardware. POSIX only, like the rest of the tests.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hidapi.h"
+#include "mock_hidapi.h"
+#include "drv_oculus_rift/rift.h"
+
+#define MOCK_VENDOR_ID 0x2833
+#define MOCK_PRODUCT_ID 0x0001 // DK1
+#define MOCK_PATH_PREFIX "mock-rift-"
+
+#define SAMPLE_RATE 1000.0
+#define SENSOR_REPORT_SIZE 62
+// reports the host buffers when they aren't read, as the libusb backend of hidapi does
+#define HOST_BUFFER_SIZE 30
+
+struct hid_device_ {
+	int index;
+	bool nonblocking;
+	ohmd_mock_hid_config config;
+
+	// host time of sample 0
+	double start;
+
+	// the next report the device sends, report_tick is its newest sample
+	unsigned int next_report, report_tick;
+	double report_time; // when it arrives at the host
+	bool report_dropped;
+	bool report_ready;
+
+	// newest sample of the last report sent
+	unsigned int last_tick;
+	unsigned int num_sent;
+	uint32_t rng;
+
+	uint16_t last_command_id;
+	uint8_t config_flags, packet_interval;
+	bool in_feature_report;
+	pthread_t opener;
+};
+
+// guards config, stats and the feature state of the devices
+static pthread_mutex_t mock_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// see ohmd_mock_hid_get_default_config
+static ohmd_mock_hid_config mock_config = {
+	1, 1000.0, 0, 0, 0, 0, 1, 0, 1280, 800,
+	{{ 0, 0, 0 }}, {{ 0, 9.81f, 0 }}, NULL
+};
+
+static ohmd_mock_hid_stats mock_stats;
+static unsigned int concurrent_feature_reports;
+
+void ohmd_mock_hid_get_default_config(ohmd_mock_hid_config* config)
+{
+	memset(config, 0, sizeof(ohmd_mock_hid_config));
+	config->num_devices = 1;
+	config->report_rate = 1000.0;
+	config->seed = 1;
+	config->h_resolution = 1280;
+	config->v_resolution = 800;
+	config->acceleration.y = 9.81f;
+}
+
+void ohmd_mock_hid_set_config(const ohmd_mock_hid_config* config)
+{
+	pthread_mutex_lock(&mock_mutex);
+	mock_config = *config;
+	memset(&mock_stats, 0, sizeof(mock_stats));
+	concurrent_feature_reports = 0;
+	pthread_mutex_unlock(&mock_mutex);
+}
+
+void ohmd_mock_hid_get_stats(ohmd_mock_hid_stats* stats)
+{
+	pthread_mutex_lock(&mock_mutex);
+	*stats = mock_stats;
+	pthread_mutex_unlock(&mock_mutex);
+}
+
+// uniform in [0, 1), the devices don't share any state so every device has its own
+static double next_random(hid_device* dev)
+{
+	dev->rng = dev->rng * 1103515245 + 12345;
+	return (double)(dev->rng >> 8) / (double)(1 << 24);
+}
+
+int hid_init(void)
+{
+	return 0;
+}
+
+int hid_exit(void)
+{
+	return 0;
+}
+
+struct hid_device_info* hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	if((vendor_id && vendor_id != MOCK_VENDOR_ID) || (product_id && product_id != MOCK_PRODUCT_ID))
+		return NULL;
+
+	pthread_mutex_lock(&mock_mutex);
+	int num_devices = mock_config.num_devices;
+	pthread_mutex_unlock(&mock_mutex);
+
+	struct hid_device_info* first = NULL;
+
+	for(int i = num_devices - 1; i >= 0; i--){
+		struct hid_device_info* info = calloc(1, sizeof(struct hid_device_info));
+		if(!info)
+			break;
+
+		info->path = malloc(32);
+		info->serial_number = malloc(16 * sizeof(wchar_t));
+		if(!info->path || !info->serial_number){
+			free(info->path);
+			free(info->serial_number);
+			free(info);
+			break;
+		}
+
+		snprintf(info->path, 32, MOCK_PATH_PREFIX "%d", i);
+		swprintf(info->serial_number, 16, L"MOCK%04d", i);
+		info->vendor_id = MOCK_VENDOR_ID;
+		info->product_id = MOCK_PRODUCT_ID;
+		info->next = first;
+		first = info;
+	}
+
+	return first;
+}
+
+void hid_free_enumeration(struct hid_device_info* devs)
+{
+	while(devs){
+		struct hid_device_info* next = devs->next;
+		free(devs->path);
+		free(devs->serial_number);
+		free(devs);
+		devs = next;
+	}
+}
+
+hid_device* hid_open_path(const char* path)
+{
+	if(strncmp(path, MOCK_PATH_PREFIX, strlen(MOCK_PATH_PREFIX)) != 0)
+		return NULL;
+
+	int index = atoi(path + strlen(MOCK_PATH_PREFIX));
+
+	hid_device* dev = calloc(1, sizeof(hid_device));
+	if(!dev)
+		return NULL;
+
+	pthread_mutex_lock(&mock_mutex);
+	dev->config = mock_config;
+	pthread_mutex_unlock(&mock_mutex);
+
+	if(index < 0 || index >= dev->config.num_devices){
+		free(dev);
+		return NULL;
+	}
+
+	dev->index = index;
+	dev->config.report_rate = OHMD_MAX(1.0, OHMD_MIN(dev->config.report_rate, SAMPLE_RATE));
+	dev->rng = dev->config.seed + index;
+	dev->start = ohmd_get_tick();
+	dev->opener = pthread_self();
+	dev->config_flags = RIFT_SCF_USE_CALIBRATION | RIFT_SCF_AUTO_CALIBRATION;
+	dev->packet_interval = 0;
+
+	return dev;
+}
+
+void hid_close(hid_device* device)
+{
+	free(device);
+}
+
+int hid_write(hid_device* device, const unsigned char* data, size_t length)
+{
+	(void)device;
+	(void)data;
+	return (int)length;
+}
+
+int hid_set_nonblocking(hid_device* device, int nonblock)
+{
+	device->nonblocking = nonblock != 0;
+	return 0;
+}
+
+// schedules the next report the device sends, skipping report slots with no new samples
+static void prepare_report(hid_device* dev)
+{
+	do {
+		dev->next_report++;
+		dev->report_tick = (unsigned int)(dev->next_report * SAMPLE_RATE / dev->config.report_rate);
+	} while(dev->report_tick == dev->last_tick);
+
+	double sent = dev->start + dev->report_tick / SAMPLE_RATE;
+
+	// jitter delays reports but never reorders them
+	dev->report_time = OHMD_MAX(sent + next_random(dev) * dev->config.jitter, dev->report_time);
+	dev->report_dropped = next_random(dev) < dev->config.drop_rate;
+	dev->report_ready = true;
+}
+
+static int encode_report(hid_device* dev, unsigned char* buffer)
+{
+	unsigned int num_samples = dev->report_tick - dev->last_tick;
+	pkt_tracker_sensor msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.num_samples = (uint8_t)OHMD_MIN(num_samples, 255);
+	msg.timestamp = dev->config.first_timestamp + dev->last_tick;
+	msg.last_command_id = dev->last_command_id;
+	msg.temperature = 2500; // 25 degrees C
+
+	// the newest samples, oldest first
+	int count = OHMD_MIN(num_samples, 3);
+	for(int i = 0; i < count; i++){
+		unsigned int tick = dev->report_tick - (count - 1 - i);
+		vec3f angular_velocity = dev->config.angular_velocity, acceleration = dev->config.acceleration;
+
+		if(dev->config.motion)
+			dev->config.motion(tick / SAMPLE_RATE, &angular_velocity, &acceleration);
+
+		rift_vec_from_vec3f(&acceleration, msg.samples[i].accel);
+		rift_vec_from_vec3f(&angular_velocity, msg.samples[i].gyro);
+	}
+
+	// a constant magnetic field
+	msg.mag[0] = 0x10;
+	msg.mag[1] = 0x20;
+	msg.mag[2] = 0x30;
+
+	return encode_tracker_sensor_msg(buffer, &msg);
+}
+
+int hid_read_timeout(hid_device* dev, unsigned char* data, size_t length, int milliseconds)
+{
+	double deadline = ohmd_get_tick() + milliseconds / 1000.0;
+
+	if(length < SENSOR_REPORT_SIZE)
+		return -1;
+
+	while(true){
+		// a device that sent all of its reports stays quiet
+		if(dev->config.max_reports && dev->num_sent >= dev->config.max_reports){
+			double left = deadline - ohmd_get_tick();
+			if(milliseconds >= 0){
+				if(left > 0)
+					ohmd_sleep(left);
+				return 0;
+			}
+
+			ohmd_sleep(0.01);
+			continue;
+		}
+
+		if(!dev->report_ready)
+			prepare_report(dev);
+
+		double now = ohmd_get_tick();
+
+		if(now >= dev->report_time){
+			dev->report_ready = false;
+
+			// the oldest reports are lost when the host buffer is full
+			bool overflowed = (now - dev->report_time) * dev->config.report_rate >= HOST_BUFFER_SIZE;
+			bool dropped = dev->report_dropped || overflowed;
+
+			// the device moves on whether or not the host got the report
+			int size = encode_report(dev, data);
+			dev->last_tick = dev->report_tick;
+			dev->num_sent++;
+
+			pthread_mutex_lock(&mock_mutex);
+			if(overflowed)
+				mock_stats.overflowed_reports++;
+			else if(dropped)
+				mock_stats.dropped_reports++;
+			else
+				mock_stats.input_reports++;
+			pthread_mutex_unlock(&mock_mutex);
+
+			if(!dropped)
+				return size;
+
+			continue;
+		}
+
+		if(milliseconds == 0 || (milliseconds > 0 && now >= deadline))
+			return 0;
+
+		double wait = dev->report_time - now;
+		if(milliseconds > 0)
+			wait = OHMD_MIN(wait, deadline - now);
+
+		ohmd_sleep(wait);
+	}
+}
+
+int hid_read(hid_device* device, unsigned char* data, size_t length)
+{
+	return hid_read_timeout(device, data, length, device->nonblocking ? 0 : -1);
+}
+
+#define WRITE16(_p, _v) (_p)[0] = (_v) & 0xff; (_p)[1] = ((_v) >> 8) & 0xff;
+#define WRITE32(_p, _v) WRITE16(_p, (_v) & 0xffff); WRITE16((_p) + 2, ((_v) >> 16) & 0xffff);
+
+static int get_display_info(hid_device* dev, unsigned char* buffer)
+{
+	// the DK1 screen and lenses
+	float distortion_k[6] = { 1.0f, 0.22f, 0.24f, 0, 0, 0 };
+
+	buffer[3] = RIFT_DT_DISTORTION;
+	WRITE16(buffer + 4, dev->config.h_resolution);
+	WRITE16(buffer + 6, dev->config.v_resolution);
+
+	// in micrometers
+	WRITE32(buffer + 8, 149760);
+	WRITE32(buffer + 12, 93600);
+	WRITE32(buffer + 16, 46800);
+	WRITE32(buffer + 20, 63500);
+	WRITE32(buffer + 24, 41000);
+	WRITE32(buffer + 28, 41000);
+
+	memcpy(buffer + 32, distortion_k, sizeof(distortion_k));
+
+	return 56;
+}
+
+// waits out the round trip of a feature report and returns with mock_mutex held,
+// a real device handles one at a time so overlapping ones are counted
+static void feature_round_trip(hid_device* dev)
+{
+	pthread_mutex_lock(&mock_mutex);
+	if(dev->in_feature_report)
+		mock_stats.overlapping_feature_reports++;
+	dev->in_feature_report = true;
+	concurrent_feature_reports++;
+	mock_stats.max_concurrent_feature_reports = OHMD_MAX(mock_stats.max_concurrent_feature_reports, concurrent_feature_reports);
+	pthread_mutex_unlock(&mock_mutex);
+
+	ohmd_sleep(dev->config.feature_latency);
+
+	pthread_mutex_lock(&mock_mutex);
+	dev->in_feature_report = false;
+	concurrent_feature_reports--;
+	mock_stats.feature_reports++;
+	if(pthread_equal(pthread_self(), dev->opener))
+		mock_stats.opener_feature_reports++;
+}
+
+int hid_get_feature_report(hid_device* dev, unsigned char* data, size_t length)
+{
+	if(length < 56)
+		return -1;
+
+	feature_round_trip(dev);
+
+	int size = -1;
+	unsigned char cmd = data[0];
+	memset(data, 0, length);
+	data[0] = cmd;
+
+	switch(cmd){
+	case RIFT_CMD_RANGE:
+		data[3] = 4; // accel, in g
+		WRITE16(data + 4, 250); // gyro, in degrees per second
+		WRITE16(data + 6, 1000); // mag, in milligauss
+		size = 8;
+		break;
+
+	case RIFT_CMD_DISPLAY_INFO:
+		size = get_display_info(dev, data);
+		break;
+
+	case RIFT_CMD_SENSOR_CONFIG:
+		WRITE16(data + 1, dev->last_command_id);
+		data[3] = dev->config_flags;
+		data[4] = dev->packet_interval;
+		WRITE16(data + 5, 1000); // the keep alive interval can't be changed
+		size = 7;
+		break;
+
+	default:
+		break;
+	}
+
+	pthread_mutex_unlock(&mock_mutex);
+
+	return size;
+}
+
+int hid_send_feature_report(hid_device* dev, const unsigned char* data, size_t length)
+{
+	if(length < 1)
+		return -1;
+
+	feature_round_trip(dev);
+
+	if(length >= 3)
+		dev->last_command_id = data[1] | (data[2] << 8);
+
+	if(data[0] == RIFT_CMD_SENSOR_CONFIG && length >= 7){
+		dev->config_flags = data[3];
+		dev->packet_interval = data[4];
+	}else if(data[0] == RIFT_CMD_KEEP_ALIVE){
+		mock_stats.keep_alives++;
+	}
+
+	pthread_mutex_unlock(&mock_mutex);
+
+	return (int)length;
+}
+
+int hid_get_serial_number_string(hid_device* device, wchar_t* string, size_t maxlen)
+{
+	swprintf(string, maxlen, L"MOCK%04d", device->index);
+	return 0;
+}
+
+const wchar_t* hid_error(hid_device* device)
+{
+	(void)device;
+	return L"mock hidapi error";
+}
@@ -0,0 +1,55 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Mock HIDAPI - The Subset of hidapi.h Used by the Rift Driver */
+
+// Stands in for the real hidapi.h when building with the mock hidapi,
+// see mock_hidapi.h for the emulated devices.
+
+#ifndef HIDAPI_H__
+#define HIDAPI_H__
+
+#include <stddef.h>
+#include <wchar.h>
+
+typedef struct hid_device_ hid_device;
+
+struct hid_device_info {
+	char* path;
+	unsigned short vendor_id;
+	unsigned short product_id;
+	wchar_t* serial_number;
+	unsigned short release_number;
+	wchar_t* manufacturer_string;
+	wchar_t* product_string;
+	unsigned short usage_page;
+	unsigned short usage;
+	int interface_number;
+	struct hid_device_info* next;
+};
+
+int hid_init(void);
+int hid_exit(void);
+
+struct hid_device_info* hid_enumerate(unsigned short vendor_id, unsigned short product_id);
+void hid_free_enumeration(struct hid_device_info* devs);
+
+hid_device* hid_open_path(const char* path);
+void hid_close(hid_device* device);
+
+int hid_write(hid_device* device, const unsigned char* data, size_t length);
+int hid_read_timeout(hid_device* device, unsigned char* data, size_t length, int milliseconds);
+int hid_read(hid_device* device, unsigned char* data, size_t length);
+int hid_set_nonblocking(hid_device* device, int nonblock);
+
+int hid_send_feature_report(hid_device* device, const unsigned char* data, size_t length);
+int hid_get_feature_report(hid_device* device, unsigned char* data, size_t length);
+
+int hid_get_serial_number_string(hid_device* device, wchar_t* string, size_t maxlen);
+const wchar_t* hid_error(hid_device* device);
+
+#endif
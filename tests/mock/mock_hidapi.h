@@ -0,0 +1,59 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Mock HIDAPI - Emulated Rift DK1s */
+
+#ifndef MOCK_HIDAPI_H
+#define MOCK_HIDAPI_H
+
+#include "openhmdi.h"
+
+// Every emulated DK1 samples its sensors at 1 kHz from when it's opened, and
+// sends input reports carrying the samples taken since its last report. The
+// timestamp of a report is the 16 bit sample counter value of its first sample,
+// the counter starting at first_timestamp, so normally it's the timestamp of
+// the previous report plus its num_samples. A report can carry at most three
+// samples, the newest ones.
+
+// generates the motion of a device, time is in seconds since it was opened
+typedef void (*ohmd_mock_hid_motion_fn)(double time, vec3f* angular_velocity, vec3f* acceleration);
+
+typedef struct {
+	int num_devices; // DK1s listed by hid_enumerate
+	double report_rate; // input reports per second, at most 1000 as that's the sample rate
+	double jitter; // input reports arrive up to this much late, in seconds
+	double drop_rate; // the fraction of input reports that never arrive
+	unsigned int max_reports; // input reports each device sends before going quiet, 0 for no limit
+	double feature_latency; // how long each feature report takes, in seconds
+	unsigned int seed; // for the jitter and drops
+	uint16_t first_timestamp; // sample counter value of the first sample, to test the wraparound
+	uint16_t h_resolution, v_resolution; // of the screen, as reported in the display info
+
+	// the motion of every device, constant unless motion is set
+	vec3f angular_velocity; // in rad/s
+	vec3f acceleration; // in m/s^2
+	ohmd_mock_hid_motion_fn motion;
+} ohmd_mock_hid_config;
+
+typedef struct {
+	unsigned int input_reports; // delivered to the host
+	unsigned int dropped_reports; // sent by the devices but lost
+	unsigned int overflowed_reports; // lost because the host didn't read them in time
+	unsigned int feature_reports; // gets and sends
+	unsigned int opener_feature_reports; // of those, made by the thread that opened the device
+	unsigned int max_concurrent_feature_reports; // in progress at once, across all devices
+	unsigned int overlapping_feature_reports; // started while another one to the same device was in progress
+	unsigned int keep_alives;
+} ohmd_mock_hid_stats;
+
+// one DK1 at rest reporting at 1 kHz, with no jitter, drops or latency and a 1280x800 screen
+void ohmd_mock_hid_get_default_config(ohmd_mock_hid_config* config);
+// takes effect for devices opened after the call, and resets the stats
+void ohmd_mock_hid_set_config(const ohmd_mock_hid_config* config);
+void ohmd_mock_hid_get_stats(ohmd_mock_hid_stats* stats);
+
+#endif
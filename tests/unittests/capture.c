@@ -0,0 +1,255 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Unit Tests - Raw Device Capture and Replay */
+
+#include "tests.h"
+#include "drv_oculus_rift/rift.h"
+#include <string.h>
+
+#define CAPTURE_TEST_FILE "unittests.capture"
+#define REPLAY_NUM_REPORTS 500
+
+void test_capture_write_read()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_capture* capture = ohmd_create_capture(ctx, CAPTURE_TEST_FILE, 1);
+	TAssert(capture);
+
+	unsigned char report[64];
+	double max_write = 0;
+
+	for(int i = 0; i < 2000; i++){
+		memset(report, i & 0xff, sizeof(report));
+
+		double start = ohmd_get_tick();
+		ohmd_capture_write(capture, i % 10 == 0 ? OHMD_CAPTURE_FEATURE_REPORT : OHMD_CAPTURE_INPUT_REPORT,
+			i * 0.001, report, 1 + i % 64);
+		max_write = OHMD_MAX(max_write, ohmd_get_tick() - start);
+
+		// let the writer thread flush in between
+		if(i == 1000)
+			ohmd_sleep(0.2);
+	}
+
+	// writes only ever copy to memory
+	TAssert(max_write < 0.01);
+
+	ohmd_destroy_capture(capture);
+
+	FILE* file = fopen(CAPTURE_TEST_FILE, "rb");
+	TAssert(file);
+
+	int revision = 0;
+	TAssert(ohmd_capture_read_header(file, &revision));
+	TAssert(revision == 1);
+
+	ohmd_capture_record record;
+	int count = 0;
+
+	while(ohmd_capture_read_record(file, &record)){
+		TAssert(record.time == count * 0.001);
+		TAssert(record.type == (count % 10 == 0 ? OHMD_CAPTURE_FEATURE_REPORT : OHMD_CAPTURE_INPUT_REPORT));
+		TAssert(record.size == 1 + count % 64);
+		TAssert(record.data[0] == (count & 0xff) && record.data[record.size - 1] == (count & 0xff));
+		count++;
+	}
+
+	TAssert(count == 2000);
+
+	fclose(file);
+	remove(CAPTURE_TEST_FILE);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_capture_create_new()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	remove(CAPTURE_TEST_FILE);
+
+	bool exists = true;
+	ohmd_capture* capture = ohmd_create_new_capture(ctx, CAPTURE_TEST_FILE, 1, &exists);
+	TAssert(capture && !exists);
+
+	unsigned char report[8] = { 0 };
+	ohmd_capture_write(capture, OHMD_CAPTURE_INPUT_REPORT, 0, report, sizeof(report));
+	ohmd_destroy_capture(capture);
+
+	// a second one doesn't replace it
+	TAssert(ohmd_create_new_capture(ctx, CAPTURE_TEST_FILE, 2, &exists) == NULL);
+	TAssert(exists);
+
+	FILE* file = fopen(CAPTURE_TEST_FILE, "rb");
+	TAssert(file);
+
+	int revision = 0;
+	ohmd_capture_record record;
+	TAssert(ohmd_capture_read_header(file, &revision) && revision == 1);
+	TAssert(ohmd_capture_read_record(file, &record) && record.size == sizeof(report));
+
+	fclose(file);
+	remove(CAPTURE_TEST_FILE);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+// a capture of a Rift with a 1920x1080 screen turning about the y axis at 1 rad/s,
+// the display info is read before input report display_info_at
+static void write_replay_capture(int display_info_at)
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_capture* capture = ohmd_create_capture(ctx, CAPTURE_TEST_FILE, 0);
+	TAssert(capture);
+
+	unsigned char report[64];
+	pkt_tracker_sensor msg = { 1 };
+	vec3f accel = {{ 0, 9.81f, 0 }}, gyro = {{ 0, 1.0f, 0 }};
+
+	rift_vec_from_vec3f(&accel, msg.samples[0].accel);
+	rift_vec_from_vec3f(&gyro, msg.samples[0].gyro);
+
+	for(int i = 0; i < REPLAY_NUM_REPORTS; i++){
+		if(i == display_info_at){
+			memset(report, 0, sizeof(report));
+			report[0] = RIFT_CMD_DISPLAY_INFO;
+			report[4] = 1920 & 0xff; report[5] = 1920 >> 8;
+			report[6] = 1080 & 0xff; report[7] = 1080 >> 8;
+			ohmd_capture_write(capture, OHMD_CAPTURE_FEATURE_REPORT, 101.0 + i * 0.001 - 0.0005, report, 56);
+		}
+
+		msg.timestamp = i;
+		int size = encode_tracker_sensor_msg(report, &msg);
+
+		ohmd_capture_write(capture, OHMD_CAPTURE_INPUT_REPORT, 101.0 + i * 0.001, report, size);
+	}
+
+	ohmd_destroy_capture(capture);
+	ohmd_ctx_destroy(ctx);
+}
+
+static ohmd_device* open_replay(ohmd_context** ctx, const char* mode)
+{
+	set_env("OPENHMD_REPLAY_FILE", CAPTURE_TEST_FILE);
+	set_env("OPENHMD_REPLAY_MODE", mode);
+
+	ohmd_ctx_settings* ctx_settings = ohmd_ctx_settings_create();
+	int drivers = OHMD_DRV_REPLAY;
+	TAssert(ohmd_ctx_settings_seti(ctx_settings, OHMD_ICS_DRIVERS, &drivers) == 0);
+
+	*ctx = ohmd_ctx_create_ex(ctx_settings);
+	ohmd_ctx_settings_destroy(ctx_settings);
+	TAssert(*ctx);
+	TAssert(ohmd_ctx_probe(*ctx) == 1);
+	TAssert(strcmp(ohmd_list_gets(*ctx, 0, OHMD_PRODUCT), "Replayed Rift") == 0);
+
+	// updates are up to the test
+	ohmd_device_settings* settings = ohmd_device_settings_create(*ctx);
+	int auto_update = 0;
+	ohmd_device_settings_seti(settings, OHMD_IDS_AUTOMATIC_UPDATE, &auto_update);
+
+	ohmd_device* dev = ohmd_list_open_device_s(*ctx, 0, settings);
+	TAssert(dev);
+
+	ohmd_device_settings_destroy(settings);
+	return dev;
+}
+
+void test_capture_replay()
+{
+	write_replay_capture(0);
+
+	ohmd_context* ctx;
+	int value;
+
+	// everything at once
+	ohmd_device* dev = open_replay(&ctx, "fast");
+	double open_time = ohmd_get_tick();
+
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_HORIZONTAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1920);
+
+	ohmd_ctx_update(ctx);
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &value) == 0);
+	TAssert(value == REPLAY_NUM_REPORTS);
+
+	// the samples keep their spacing, starting when the device was opened
+	double time;
+	TAssert(ohmd_device_get_sample_time(dev, &time) == 0);
+	TAssert(fabs(time - (open_time + (REPLAY_NUM_REPORTS - 1) * 0.001)) < 0.05);
+
+	// half a radian about the y axis
+	quatf rot;
+	TAssert(ohmd_device_getf(dev, OHMD_ROTATION_QUAT, rot.arr) == 0);
+	TAssert(float_eq(2.0f * acosf(rot.w), 0.5f, 0.01f));
+	TAssert(fabsf(rot.x) < 0.001f && fabsf(rot.z) < 0.001f);
+
+	ohmd_ctx_destroy(ctx);
+
+	// one report per update
+	dev = open_replay(&ctx, "paced");
+	for(int i = 0; i < 3; i++)
+		ohmd_ctx_update(ctx);
+
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &value) == 0);
+	TAssert(value == 3);
+
+	ohmd_ctx_destroy(ctx);
+
+	// as fast as they were captured
+	dev = open_replay(&ctx, "realtime");
+	ohmd_ctx_update(ctx);
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &value) == 0);
+	TAssert(value >= 1 && value < REPLAY_NUM_REPORTS / 2);
+
+	ohmd_sleep(0.6);
+	ohmd_ctx_update(ctx);
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &value) == 0);
+	TAssert(value == REPLAY_NUM_REPORTS);
+
+	ohmd_ctx_destroy(ctx);
+
+	remove(CAPTURE_TEST_FILE);
+}
+
+void test_capture_replay_interleaved()
+{
+	// as captured when the Rift was opened from its config cache
+	write_replay_capture(REPLAY_NUM_REPORTS / 2);
+
+	ohmd_context* ctx;
+	int value;
+
+	// the screen is known from the start, not just once the display info is replayed
+	ohmd_device* dev = open_replay(&ctx, "paced");
+
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_HORIZONTAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1920);
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_VERTICAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1080);
+
+	// and the display info doesn't take an update of its own
+	for(int i = 0; i < REPLAY_NUM_REPORTS; i++)
+		ohmd_ctx_update(ctx);
+
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &value) == 0);
+	TAssert(value == REPLAY_NUM_REPORTS);
+
+	quatf rot;
+	TAssert(ohmd_device_getf(dev, OHMD_ROTATION_QUAT, rot.arr) == 0);
+	TAssert(float_eq(2.0f * acosf(rot.w), 0.5f, 0.01f));
+
+	ohmd_ctx_destroy(ctx);
+
+	remove(CAPTURE_TEST_FILE);
+}
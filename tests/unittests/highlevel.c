@@ -9,6 +9,7 @@
 
 #include "tests.h"
 #include "openhmd.h"
+#include <string.h>
 
 void test_highlevel_open_close_device()
 {
@@ -67,3 +68,552 @@ void test_highlevel_open_close_many_devices()
 	
 	ohmd_ctx_destroy(ctx);	
 }
+
+static volatile bool slow_update_running;
+
+static void slow_update(ohmd_device* device)
+{
+	slow_update_running = true;
+	ohmd_sleep(0.2);
+	slow_update_running = false;
+}
+
+void test_highlevel_slow_update_isolated()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 0);
+
+	ohmd_device* slow = ohmd_list_open_device(ctx, num_devices - 1);
+	ohmd_device* fast = ohmd_list_open_device(ctx, num_devices - 1);
+	TAssert(slow && fast);
+
+	// stall the update thread inside the first device
+	slow->update = slow_update;
+	while(!slow_update_running)
+		ohmd_sleep(0.001);
+
+	// the other device can still be read and written
+	double start = ohmd_get_tick();
+	float ipd = 0.065f, q[4];
+	TAssert(ohmd_device_setf(fast, OHMD_EYE_IPD, &ipd) == 0);
+	TAssert(ohmd_device_getf(fast, OHMD_ROTATION_QUAT, q) == 0);
+	TAssert(ohmd_get_tick() - start < 0.1);
+
+	// and the context isn't locked, devices can be looked up and opened meanwhile
+	start = ohmd_get_tick();
+	TAssert(ohmd_list_get_id(ctx, num_devices - 1) > 0);
+	TAssert(ohmd_list_open_device(ctx, num_devices - 1));
+	TAssert(ohmd_get_tick() - start < 0.1);
+	TAssert(slow_update_running);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+static volatile int waitable_updates;
+
+static void waitable_update(ohmd_device* device)
+{
+	waitable_updates++;
+}
+
+// only dedicated update threads call it, the shared one waits on the context
+static bool no_wait_for_data(ohmd_device* device, double timeout)
+{
+	return false;
+}
+
+void test_highlevel_close_waiting_device()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 0);
+
+	ohmd_device* first = ohmd_list_open_device(ctx, num_devices - 1);
+	ohmd_device* second = ohmd_list_open_device(ctx, num_devices - 1);
+	TAssert(first && second);
+
+	first->wait_for_data = no_wait_for_data;
+	second->wait_for_data = no_wait_for_data;
+	first->update = waitable_update;
+	second->update = waitable_update;
+
+	// the update thread blocks on both devices at once instead of polling them,
+	// polling would update them about a hundred times meanwhile
+	ohmd_sleep(0.05);
+	int updates = waitable_updates;
+	ohmd_sleep(0.1);
+	TAssert(waitable_updates - updates <= 4);
+
+	// until either of them has data
+	updates = waitable_updates;
+	ohmd_device_signal_data(second);
+	for(int i = 0; i < 100 && waitable_updates - updates < 2; i++)
+		ohmd_sleep(0.01);
+	TAssert(waitable_updates - updates >= 2);
+
+	// the thread doesn't hold on to the devices while it waits
+	TAssert(ohmd_close_device(first) == 0);
+	TAssert(ohmd_close_device(second) == 0);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+static ohmd_device* close_target;
+static volatile int close_result;
+
+static void OHMD_APIENTRY close_other_device(ohmd_device* device, double time, const float* rotation, const float* position, void* user_data)
+{
+	close_result = ohmd_close_device(close_target);
+}
+
+void test_highlevel_close_from_callback()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 0);
+
+	ohmd_device* first = ohmd_list_open_device(ctx, num_devices - 1);
+	ohmd_device* second = ohmd_list_open_device(ctx, num_devices - 1);
+	TAssert(first && second);
+
+	close_target = second;
+	close_result = 1;
+	TAssert(ohmd_device_set_pose_callback(first, close_other_device, NULL) == 0);
+
+	// the update thread holds both devices while it makes the callback, closing would wait for itself
+	quatf orient = {{0, 0, 0, 1}};
+	vec3f ang_vel = {{0, 0, 0}};
+
+	ohmd_lock_mutex(first->update_mutex);
+	ohmd_device_push_sample(first, ohmd_get_time(), &orient, &ang_vel);
+	ohmd_unlock_mutex(first->update_mutex);
+
+	for(int i = 0; i < 100 && close_result == 1; i++)
+		ohmd_sleep(0.01);
+	TAssert(close_result == OHMD_S_INVALID_PARAMETER);
+
+	TAssert(ohmd_device_set_pose_callback(first, NULL, NULL) == 0);
+	TAssert(ohmd_close_device(second) == 0);
+	TAssert(ohmd_close_device(first) == 0);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+static volatile int counted_updates;
+
+static void counting_update(ohmd_device* device)
+{
+	counted_updates++;
+}
+
+void test_highlevel_dedicated_update_thread()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 0);
+
+	ohmd_device_settings* settings = ohmd_device_settings_create(ctx);
+	int mode = OHMD_UPDATE_MODE_DEDICATED, rate = 100, bad_rate = -1;
+	TAssert(ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_MODE, &mode) == OHMD_S_OK);
+	TAssert(ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_RATE, &rate) == OHMD_S_OK);
+	TAssert(ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_RATE, &bad_rate) == OHMD_S_INVALID_PARAMETER);
+
+	ohmd_device* hmd = ohmd_list_open_device_s(ctx, num_devices - 1, settings);
+	TAssert(hmd);
+	ohmd_device_settings_destroy(settings);
+
+	// the device has a thread of its own, ticking at roughly the requested rate
+	TAssert(hmd->update_thread);
+	TAssert(ctx->update_thread == NULL);
+
+	hmd->update = counting_update;
+	ohmd_sleep(0.2);
+	int updates = counted_updates;
+	TAssert(updates > 5 && updates < 40);
+
+	// cpus that can't exist are refused rather than shifted out of the mask
+	TAssert(!ohmd_set_thread_affinity(hmd->update_thread, -2));
+	TAssert(!ohmd_set_thread_affinity(hmd->update_thread, 1 << 20));
+
+	TAssert(ohmd_close_device(hmd) == 0);
+
+	// a slow fixed rate doesn't hold up closing the device for a whole period
+	settings = ohmd_device_settings_create(ctx);
+	rate = 1;
+	TAssert(ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_MODE, &mode) == OHMD_S_OK);
+	TAssert(ohmd_device_settings_seti(settings, OHMD_IDS_UPDATE_RATE, &rate) == OHMD_S_OK);
+
+	hmd = ohmd_list_open_device_s(ctx, num_devices - 1, settings);
+	TAssert(hmd);
+	ohmd_device_settings_destroy(settings);
+
+	ohmd_sleep(0.05);
+	double start = ohmd_get_tick();
+	TAssert(ohmd_close_device(hmd) == 0);
+	TAssert(ohmd_get_tick() - start < 0.1);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_highlevel_open_close_hundreds_of_devices()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	// more than the registry used to have room for
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 0);
+
+	ohmd_device* hmds[300];
+
+	for(int i = 0; i < 300; i++){
+		hmds[i] = ohmd_list_open_device(ctx, num_devices - 1);
+		TAssert(hmds[i]);
+	}
+
+	for(int i = 0; i < 300; i += 3){
+		TAssert(ohmd_close_device(hmds[i]) == 0);
+		hmds[i] = NULL;
+	}
+
+	TAssert(ctx->num_active_devices == 200);
+
+	// every remaining device can still be found where it thinks it is
+	for(int i = 0; i < 300; i++){
+		if(hmds[i])
+			TAssert(ctx->active_devices[hmds[i]->active_device_idx] == hmds[i]);
+	}
+
+	ohmd_ctx_update(ctx);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_highlevel_device_list_growth()
+{
+	ohmd_device_list list = { 0 };
+
+	for(int i = 0; i < 100; i++){
+		ohmd_device_desc* desc = ohmd_device_list_add(&list);
+		TAssert(desc);
+		TAssert(desc->revision == 0);
+		desc->revision = i;
+	}
+
+	TAssert(list.num_devices == 100);
+
+	for(int i = 0; i < 100; i++)
+		TAssert(list.devices[i].revision == i);
+
+	free(list.devices);
+}
+
+static void slow_get_device_list(ohmd_driver* driver, ohmd_device_list* list)
+{
+	ohmd_sleep(0.2);
+
+	ohmd_device_desc* desc = ohmd_device_list_add(list);
+	TAssert(desc);
+
+	strcpy(desc->driver, "Slow Driver");
+	snprintf(desc->path, OHMD_STR_SIZE, "%p", (void*)driver);
+	desc->driver_ptr = driver;
+}
+
+static volatile bool slow_open_running;
+
+static ohmd_device* slow_open_device(ohmd_driver* driver, ohmd_device_desc* desc)
+{
+	slow_open_running = true;
+	ohmd_sleep(0.2);
+	slow_open_running = false;
+
+	// the device itself is a dummy one
+	ohmd_driver* dummy = ohmd_create_dummy_drv(driver->ctx);
+	TAssert(dummy);
+
+	ohmd_device* device = dummy->open_device(dummy, desc);
+	dummy->destroy(dummy);
+
+	return device;
+}
+
+static void slow_destroy(ohmd_driver* driver)
+{
+	free(driver);
+}
+
+static void add_slow_driver(ohmd_context* ctx)
+{
+	ohmd_driver* drv = calloc(1, sizeof(ohmd_driver));
+	TAssert(drv);
+
+	drv->get_device_list = slow_get_device_list;
+	drv->open_device = slow_open_device;
+	drv->destroy = slow_destroy;
+	drv->ctx = ctx;
+
+	ohmd_add_driver(ctx, drv);
+}
+
+static volatile int probe_callback_devices;
+
+static void OHMD_APIENTRY on_probe(ohmd_context* ctx, int num_devices, void* user_data)
+{
+	probe_callback_devices = num_devices;
+}
+
+static volatile int restart_result;
+
+static void OHMD_APIENTRY on_probe_restart(ohmd_context* ctx, int num_devices, void* user_data)
+{
+	restart_result = ohmd_ctx_probe_async(ctx, NULL, NULL);
+}
+
+void test_highlevel_probe_async()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	int num_builtin = ohmd_ctx_probe(ctx);
+	TAssert(num_builtin > 0);
+
+	add_slow_driver(ctx);
+	add_slow_driver(ctx);
+
+	probe_callback_devices = -1;
+
+	double start = ohmd_get_time();
+	TAssert(ohmd_ctx_probe_async(ctx, on_probe, NULL) == 0);
+	TAssert(ohmd_get_time() - start < 0.1);
+
+	TAssert(ohmd_ctx_wait_probe(ctx, 0.01) == OHMD_S_TIMEOUT);
+	TAssert(ohmd_ctx_wait_probe(ctx, 2.0) == num_builtin + 2);
+
+	// both slow drivers ran at the same time
+	TAssert(ohmd_get_time() - start < 0.35);
+
+	// devices are listed in driver order
+	TAssert(strcmp(ohmd_list_gets(ctx, num_builtin - 1, OHMD_PRODUCT), "Dummy Device") == 0);
+
+	// waiting again returns right away
+	TAssert(ohmd_ctx_wait_probe(ctx, 0) == num_builtin + 2);
+
+	// the callback may run just after waiters are released
+	for(int i = 0; i < 100 && probe_callback_devices < 0; i++)
+		ohmd_sleep(0.01);
+	TAssert(probe_callback_devices == num_builtin + 2);
+
+	// the callback can't start another probe, its thread would have to wait for itself
+	restart_result = 1;
+	TAssert(ohmd_ctx_probe_async(ctx, on_probe_restart, NULL) == 0);
+	for(int i = 0; i < 100 && restart_result == 1; i++)
+		ohmd_sleep(0.01);
+	TAssert(restart_result == OHMD_S_INVALID_PARAMETER);
+
+	TAssert(ohmd_ctx_probe(ctx) == num_builtin + 2);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_highlevel_ctx_create_ex()
+{
+	ohmd_ctx_settings* settings = ohmd_ctx_settings_create();
+	TAssert(settings);
+
+	int drivers = OHMD_DRV_DUMMY, lazy = 1;
+	TAssert(ohmd_ctx_settings_seti(settings, OHMD_ICS_DRIVERS, &drivers) == 0);
+	TAssert(ohmd_ctx_settings_seti(settings, OHMD_ICS_LAZY_DRIVERS, &lazy) == 0);
+	TAssert(ohmd_ctx_settings_seti(settings, (ohmd_int_ctx_settings)1000, &lazy) == OHMD_S_INVALID_PARAMETER);
+
+	ohmd_context* ctx = ohmd_ctx_create_ex(settings);
+	TAssert(ctx);
+
+	// nothing is set up before the first probe
+	TAssert(ctx->num_drivers == 0);
+
+	TAssert(ohmd_ctx_probe(ctx) == 1);
+	TAssert(ctx->num_drivers == 1);
+	TAssert(strcmp(ohmd_list_gets(ctx, 0, OHMD_PRODUCT), "Dummy Device") == 0);
+	TAssert(ohmd_list_gets(ctx, -1, OHMD_PRODUCT) == NULL);
+	TAssert(ohmd_list_gets(ctx, 1, OHMD_PRODUCT) == NULL);
+
+	// returned strings outlive the list they came from
+	const char* vendor = ohmd_list_gets(ctx, 0, OHMD_VENDOR);
+	TAssert(ohmd_ctx_probe(ctx) == 1);
+	TAssert(strcmp(vendor, "OpenHMD") == 0);
+
+	ohmd_ctx_destroy(ctx);
+
+	// no drivers at all
+	drivers = 0;
+	lazy = 0;
+	TAssert(ohmd_ctx_settings_seti(settings, OHMD_ICS_DRIVERS, &drivers) == 0);
+	TAssert(ohmd_ctx_settings_seti(settings, OHMD_ICS_LAZY_DRIVERS, &lazy) == 0);
+
+	ctx = ohmd_ctx_create_ex(settings);
+	TAssert(ctx);
+	TAssert(ohmd_ctx_probe(ctx) == 0);
+	ohmd_ctx_destroy(ctx);
+
+	ohmd_ctx_settings_destroy(settings);
+
+	// the defaults
+	ctx = ohmd_ctx_create_ex(NULL);
+	TAssert(ctx);
+	TAssert(ctx->num_drivers > 0);
+	TAssert(ohmd_ctx_probe(ctx) > 0);
+	ohmd_ctx_destroy(ctx);
+}
+
+static unsigned int open_slow_device(void* arg)
+{
+	ohmd_context* ctx = (ohmd_context*)arg;
+	TAssert(ohmd_list_open_device(ctx, ctx->list.num_devices - 1));
+	return 0;
+}
+
+void test_highlevel_open_devices()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	int num_builtin = ohmd_ctx_probe(ctx);
+	TAssert(num_builtin > 0);
+
+	for(int i = 0; i < 4; i++)
+		add_slow_driver(ctx);
+
+	TAssert(ohmd_ctx_probe(ctx) == num_builtin + 4);
+
+	ohmd_device* fast = ohmd_list_open_device(ctx, num_builtin - 1);
+	TAssert(fast);
+
+	int indices[] = { num_builtin, num_builtin + 1, num_builtin + 2, num_builtin + 3, -1 };
+	ohmd_device* devices[5];
+
+	double start = ohmd_get_time();
+	TAssert(ohmd_list_open_devices(ctx, 5, indices, NULL, devices) == 4);
+
+	// all slow devices were opened at the same time
+	TAssert(ohmd_get_time() - start < 0.5);
+
+	for(int i = 0; i < 4; i++)
+		TAssert(devices[i]);
+	TAssert(devices[4] == NULL);
+	TAssert(ctx->num_active_devices == 5);
+
+	// a slow open doesn't hold up the context
+	ohmd_thread* thread = ohmd_create_thread(ctx, open_slow_device, ctx);
+	TAssert(thread);
+	while(!slow_open_running)
+		ohmd_sleep(0.001);
+
+	start = ohmd_get_time();
+	ohmd_ctx_update(ctx);
+	TAssert(ohmd_get_time() - start < 0.1);
+	TAssert(slow_open_running);
+
+	ohmd_destroy_thread(thread);
+	TAssert(ctx->num_active_devices == 6);
+
+	TAssert(ohmd_close_device(devices[1]) == 0);
+	TAssert(ctx->num_active_devices == 5);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+static int queue_geti(ohmd_device* device, ohmd_int_value type, int* out)
+{
+	if(type != OHMD_SENSOR_QUEUE_DEPTH)
+		return OHMD_S_INVALID_PARAMETER;
+
+	*out = 42;
+	return OHMD_S_OK;
+}
+
+static ohmd_device* open_undistorted_device(ohmd_driver* driver, ohmd_device_desc* desc)
+{
+	ohmd_driver* dummy = ohmd_create_dummy_drv(driver->ctx);
+	TAssert(dummy);
+
+	ohmd_device* device = dummy->open_device(dummy, desc);
+	dummy->destroy(dummy);
+
+	device->driver_float_values = 0;
+	device->geti = queue_geti;
+	device->driver_int_values = 1 << OHMD_SENSOR_QUEUE_DEPTH;
+	return device;
+}
+
+void test_highlevel_supported_values()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 0);
+
+	ohmd_device* hmd = ohmd_list_open_device(ctx, num_devices - 1);
+	TAssert(hmd);
+
+	int floats = 0, ints = 0;
+	TAssert(ohmd_device_geti(hmd, OHMD_SUPPORTED_FLOAT_VALUES, &floats) == 0);
+	TAssert(ohmd_device_geti(hmd, OHMD_SUPPORTED_INT_VALUES, &ints) == 0);
+
+	// the dummy device has distortion values, setting values doesn't count
+	TAssert(floats & (1 << OHMD_DISTORTION_K));
+	TAssert(floats & (1 << OHMD_EYE_IPD));
+	TAssert(!(floats & (1 << OHMD_EXTERNAL_SENSOR_FUSION)));
+	TAssert(ints & (1 << OHMD_SCREEN_VERTICAL_RESOLUTION));
+	TAssert(ints & (1 << OHMD_SUPPORTED_INT_VALUES));
+
+	// every value in the mask can be read
+	float values[16];
+	for(int i = 0; i < 32; i++){
+		if(floats & (1 << i))
+			TAssert(ohmd_device_getf(hmd, (ohmd_float_value)i, values) == 0);
+	}
+
+	ohmd_ctx_destroy(ctx);
+
+	// a driver without distortion values
+	ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_driver* drv = calloc(1, sizeof(ohmd_driver));
+	TAssert(drv);
+	drv->get_device_list = slow_get_device_list;
+	drv->open_device = open_undistorted_device;
+	drv->destroy = slow_destroy;
+	drv->ctx = ctx;
+	ohmd_add_driver(ctx, drv);
+
+	num_devices = ohmd_ctx_probe(ctx);
+	hmd = ohmd_list_open_device(ctx, num_devices - 1);
+	TAssert(hmd);
+
+	TAssert(ohmd_device_geti(hmd, OHMD_SUPPORTED_FLOAT_VALUES, &floats) == 0);
+	TAssert(!(floats & (1 << OHMD_DISTORTION_K)));
+	TAssert(floats & (1 << OHMD_ROTATION_QUAT));
+
+	// driver values are added to the core ones
+	int depth = 0;
+	TAssert(ohmd_device_geti(hmd, OHMD_SUPPORTED_INT_VALUES, &ints) == 0);
+	TAssert(ints & (1 << OHMD_SENSOR_QUEUE_DEPTH));
+	TAssert(!(ints & (1 << OHMD_SENSOR_QUEUE_OVERRUNS)));
+	TAssert(ohmd_device_geti(hmd, OHMD_SENSOR_QUEUE_DEPTH, &depth) == 0);
+	TAssert(depth == 42);
+	TAssert(ohmd_device_geti(hmd, OHMD_SENSOR_QUEUE_OVERRUNS, &depth) != 0);
+
+	ohmd_ctx_destroy(ctx);
+}
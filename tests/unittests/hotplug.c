@@ -0,0 +1,215 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Unit Tests - Hotplug Monitoring */
+
+// for mkdtemp
+#define _XOPEN_SOURCE 700
+
+#include "tests.h"
+#include <string.h>
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <unistd.h>
+
+// a driver listing every hidraw* file in a directory as a device
+typedef struct {
+	ohmd_driver base;
+	char dir[OHMD_STR_SIZE];
+	volatile int num_enumerations;
+} file_driver;
+
+static void file_get_device_list(ohmd_driver* driver, ohmd_device_list* list)
+{
+	file_driver* drv = (file_driver*)driver;
+	DIR* dir = opendir(drv->dir);
+	struct dirent* entry;
+
+	TAssert(dir);
+	drv->num_enumerations++;
+
+	while((entry = readdir(dir)) != NULL){
+		if(strncmp(entry->d_name, "hidraw", 6) != 0)
+			continue;
+
+		ohmd_device_desc* desc = ohmd_device_list_add(list);
+		TAssert(desc);
+
+		strcpy(desc->driver, "File Driver");
+		snprintf(desc->path, OHMD_STR_SIZE, "%s", entry->d_name);
+		desc->driver_ptr = driver;
+	}
+
+	closedir(dir);
+}
+
+static void file_destroy(ohmd_driver* driver)
+{
+	free(driver);
+}
+
+// a driver without HID devices, that lists nothing and counts how often it's asked to
+typedef struct {
+	ohmd_driver base;
+	volatile int num_enumerations;
+} other_driver;
+
+static void other_get_device_list(ohmd_driver* driver, ohmd_device_list* list)
+{
+	((other_driver*)driver)->num_enumerations++;
+}
+
+typedef struct {
+	volatile int num_added, num_removed;
+	volatile int last_added, last_removed;
+} hotplug_events;
+
+static void OHMD_APIENTRY on_hotplug(ohmd_context* ctx, ohmd_hotplug_event event, int id, void* user_data)
+{
+	hotplug_events* events = (hotplug_events*)user_data;
+
+	if(event == OHMD_HOTPLUG_ADDED){
+		events->last_added = id;
+		events->num_added++;
+	}else{
+		events->last_removed = id;
+		events->num_removed++;
+	}
+}
+
+static void touch(const char* dir, const char* name)
+{
+	char path[OHMD_STR_SIZE * 2];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+	FILE* f = fopen(path, "w");
+	TAssert(f);
+	fclose(f);
+}
+
+static void rm(const char* dir, const char* name)
+{
+	char path[OHMD_STR_SIZE * 2];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	TAssert(unlink(path) == 0);
+}
+
+static bool wait_for(volatile int* count, int value)
+{
+	for(int i = 0; i < 200 && *count != value; i++)
+		ohmd_sleep(0.01);
+
+	return *count == value;
+}
+
+void test_hotplug_add_remove()
+{
+	char dir[] = "/tmp/ohmd-hotplug-XXXXXX";
+	TAssert(mkdtemp(dir));
+
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	file_driver* drv = calloc(1, sizeof(file_driver));
+	TAssert(drv);
+	drv->base.get_device_list = file_get_device_list;
+	drv->base.destroy = file_destroy;
+	drv->base.ctx = ctx;
+	drv->base.hid_devices = true;
+	strcpy(drv->dir, dir);
+	ohmd_add_driver(ctx, &drv->base);
+
+	other_driver* other = calloc(1, sizeof(other_driver));
+	TAssert(other);
+	other->base.get_device_list = other_get_device_list;
+	other->base.destroy = file_destroy;
+	other->base.ctx = ctx;
+	ohmd_add_driver(ctx, &other->base);
+
+	touch(dir, "hidraw0");
+
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 1);
+
+	int dummy_id = ohmd_list_get_id(ctx, 0);
+	int first_id = ohmd_list_get_id(ctx, num_devices - 1);
+	TAssert(dummy_id > 0 && first_id > 0 && dummy_id != first_id);
+
+	// probing again keeps the ids
+	TAssert(ohmd_ctx_probe(ctx) == num_devices);
+	TAssert(ohmd_list_get_id(ctx, 0) == dummy_id);
+	TAssert(ohmd_list_get_id(ctx, num_devices - 1) == first_id);
+
+	// everything is listed already, so starting reports nothing
+	hotplug_events events = { 0 };
+	TAssert(ohmd_start_hotplug(ctx, dir, "hidraw", on_hotplug, &events) == 0);
+	TAssert(events.num_added == 0);
+
+	int file_enumerations = drv->num_enumerations;
+	int other_enumerations = other->num_enumerations;
+
+	// an added node only has the HID drivers enumerated
+	touch(dir, "hidraw1");
+	TAssert(wait_for(&events.num_added, 1));
+	TAssert(drv->num_enumerations == file_enumerations + 1);
+	TAssert(other->num_enumerations == other_enumerations);
+
+	int index = ohmd_list_find_id(ctx, events.last_added);
+	TAssert(index >= 0);
+
+	// the strings of both devices can be held at once
+	const char* first_path = ohmd_list_gets(ctx, ohmd_list_find_id(ctx, first_id), OHMD_PATH);
+	const char* second_path = ohmd_list_gets(ctx, index, OHMD_PATH);
+	TAssert(first_path && second_path && first_path != second_path);
+	TAssert(strcmp(first_path, "hidraw0") == 0);
+	TAssert(strcmp(second_path, "hidraw1") == 0);
+
+	// other files are not looked at
+	touch(dir, "other");
+	ohmd_sleep(0.1);
+	TAssert(events.num_added == 1 && events.num_removed == 0);
+
+	// a removed one takes its entry along without enumerating anything
+	rm(dir, "hidraw0");
+	TAssert(wait_for(&events.num_removed, 1));
+	TAssert(events.last_removed == first_id);
+	TAssert(ohmd_list_find_id(ctx, first_id) < 0);
+	TAssert(ohmd_list_find_id(ctx, dummy_id) >= 0);
+	TAssert(drv->num_enumerations == file_enumerations + 1);
+	TAssert(other->num_enumerations == other_enumerations);
+
+	// and outlive the list they came from
+	TAssert(strcmp(first_path, "hidraw0") == 0);
+	TAssert(strcmp(second_path, "hidraw1") == 0);
+
+	ohmd_ctx_stop_hotplug(ctx);
+
+	rm(dir, "hidraw1");
+	ohmd_sleep(0.1);
+	TAssert(events.num_removed == 1);
+
+	ohmd_ctx_destroy(ctx);
+
+	rm(dir, "other");
+	TAssert(rmdir(dir) == 0);
+}
+
+#else
+
+void test_hotplug_add_remove()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	TAssert(ohmd_ctx_start_hotplug(ctx, NULL, NULL) == OHMD_S_UNSUPPORTED);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+#endif
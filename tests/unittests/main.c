@@ -7,6 +7,10 @@
 
 /* Unit Tests - Main */
 
+// for setenv
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
 #include <string.h>
 #include "tests.h"
 
@@ -15,6 +19,15 @@ bool float_eq(float a, float b, float t)
 	return fabsf(a - b) < t;
 }
 
+void set_env(const char* name, const char* value)
+{
+#ifdef _WIN32
+	_putenv_s(name, value);
+#else
+	setenv(name, value, 1);
+#endif
+}
+
 #define Test(_t) printf("   "#_t); _t(); printf("%*sok\n", 50 - (int)strlen(#_t), "");
 
 int main()
@@ -32,12 +45,64 @@ int main()
 	Test(test_oquatf_get_dot);
 	Test(test_oquatf_inverse);
 	Test(test_oquatf_diff);
+	Test(test_oquatf_slerp);
 	printf("\n");
 
 	printf("high level tests\n");
 	Test(test_highlevel_open_close_device);
 	Test(test_highlevel_open_close_many_devices);
+	Test(test_highlevel_slow_update_isolated);
+	Test(test_highlevel_close_waiting_device);
+	Test(test_highlevel_close_from_callback);
+	Test(test_highlevel_dedicated_update_thread);
+	Test(test_highlevel_open_close_hundreds_of_devices);
+	Test(test_highlevel_device_list_growth);
+	Test(test_highlevel_probe_async);
+	Test(test_highlevel_ctx_create_ex);
+	Test(test_highlevel_open_devices);
+	Test(test_highlevel_supported_values);
+	printf("\n");
+
+	printf("pose tests\n");
+	Test(test_pose_concurrent_reads);
+	Test(test_pose_history_interpolation);
+	Test(test_pose_callback);
+	Test(test_pose_wait_for_sample);
+	Test(test_pose_getf_multi);
+	Test(test_pose_get_frame);
+	Test(test_pose_publish_on_change);
+	Test(test_pose_generation);
+	printf("\n");
+
+	printf("hotplug tests\n");
+	Test(test_hotplug_add_remove);
+	printf("\n");
+
+	printf("ring tests\n");
+	Test(test_ring_depth_overruns);
+	Test(test_ring_threaded);
+	printf("\n");
+
+	printf("capture tests\n");
+	Test(test_capture_write_read);
+	Test(test_capture_create_new);
+	Test(test_capture_replay);
+	Test(test_capture_replay_interleaved);
+	printf("\n");
+
+#ifdef MOCK_HIDAPI
+	printf("rift tests\n");
+	Test(test_rift_packet_round_trip);
+	Test(test_rift_open_close);
+	Test(test_rift_dropped_reports);
+	Test(test_rift_slow_reports);
+	Test(test_rift_timestamp_wraparound);
+	Test(test_rift_feature_latency);
+	Test(test_rift_stale_cache);
+	Test(test_rift_capture_names);
+	Test(test_rift_many_devices);
 	printf("\n");
+#endif
 
 	printf("all a-ok\n");
 	return 0;
@@ -0,0 +1,429 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Unit Tests - Published Pose */
+
+#include "tests.h"
+#include <string.h>
+
+static ohmd_device* open_manual_device(ohmd_context* ctx)
+{
+	int num_devices = ohmd_ctx_probe(ctx);
+	TAssert(num_devices > 0);
+
+	ohmd_device_settings* settings = ohmd_device_settings_create(ctx);
+	int auto_update = 0;
+	ohmd_device_settings_seti(settings, OHMD_IDS_AUTOMATIC_UPDATE, &auto_update);
+
+	// Open dummy device (num_devices - 1)
+	ohmd_device* dev = ohmd_list_open_device_s(ctx, num_devices - 1, settings);
+	TAssert(dev);
+
+	ohmd_device_settings_destroy(settings);
+	return dev;
+}
+
+typedef struct {
+	ohmd_device* dev;
+	volatile bool done;
+} pose_writer;
+
+static unsigned int pose_writer_thread(void* arg)
+{
+	pose_writer* writer = (pose_writer*)arg;
+
+	for(int i = 1; i <= 200000; i++){
+		float v = (float)i;
+		quatf q = {{v, v, v, v}};
+		vec3f p = {{v, v, v}};
+
+		writer->dev->rotation = q;
+		writer->dev->position = p;
+		ohmd_device_publish_pose(writer->dev);
+	}
+
+	writer->done = true;
+	return 0;
+}
+
+void test_pose_concurrent_reads()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	pose_writer writer = { open_manual_device(ctx), false };
+
+	quatf q0 = {{0, 0, 0, 0}};
+	writer.dev->rotation = q0;
+	ohmd_device_publish_pose(writer.dev);
+
+	ohmd_thread* thread = ohmd_create_thread(ctx, pose_writer_thread, &writer);
+	TAssert(thread);
+
+	// every read must see the rotation and position from the same publish
+	while(!writer.done){
+		ohmd_pose pose;
+		ohmd_device_read_pose(writer.dev, &pose);
+
+		for(int i = 0; i < 4; i++)
+			TAssert(pose.rotation.arr[i] == pose.rotation.w);
+
+		for(int i = 0; i < 3; i++)
+			TAssert(pose.position.arr[i] == pose.rotation.w);
+	}
+
+	ohmd_destroy_thread(thread);
+
+	float q[4];
+	TAssert(ohmd_device_getf(writer.dev, OHMD_ROTATION_QUAT, q) == 0);
+	TAssert(float_eq(q[3], 200000.0f, 0.001f));
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_pose_history_interpolation()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_device* dev = open_manual_device(ctx);
+
+	float q[4];
+	TAssert(ohmd_device_get_pose_at(dev, 1.0, q) == OHMD_S_UNSUPPORTED);
+
+	// a device turning around y by 0.01 radians per millisecond, pushed
+	// through more samples than the history can hold
+	vec3f axis = {{0, 1, 0}}, ang_vel = {{0, 10, 0}};
+	for(int i = 0; i < 1000; i++){
+		quatf orient;
+		oquatf_init_axis(&orient, &axis, i * 0.01f);
+		ohmd_device_push_sample(dev, 1.0 + i * 0.001, &orient, &ang_vel);
+	}
+
+	quatf expected;
+
+	// in between two samples
+	TAssert(ohmd_device_get_pose_at(dev, 1.9005, q) == 0);
+	oquatf_init_axis(&expected, &axis, 900.5f * 0.01f);
+	TAssert(quatf_eq(*(quatf*)q, expected, 0.001f));
+
+	// predicted 20 ms past the newest sample
+	TAssert(ohmd_device_get_pose_at(dev, 1.999 + 0.02, q) == 0);
+	oquatf_init_axis(&expected, &axis, 999 * 0.01f + 0.2f);
+	TAssert(quatf_eq(*(quatf*)q, expected, 0.001f));
+
+	// predictions stop 100 ms ahead
+	TAssert(ohmd_device_get_pose_at(dev, 5.0, q) == 0);
+	oquatf_init_axis(&expected, &axis, 999 * 0.01f + 1.0f);
+	TAssert(quatf_eq(*(quatf*)q, expected, 0.001f));
+
+	// older than the history goes back
+	TAssert(ohmd_device_get_pose_at(dev, 1.0, q) == 0);
+	oquatf_init_axis(&expected, &axis, (1000 - OHMD_POSE_HISTORY_SIZE + 1) * 0.01f);
+	TAssert(quatf_eq(*(quatf*)q, expected, 0.001f));
+
+	ohmd_ctx_destroy(ctx);
+}
+
+typedef struct {
+	int num_calls;
+	double last_time;
+	quatf last_rotation;
+} pose_receiver;
+
+static void OHMD_APIENTRY receive_pose(ohmd_device* device, double time, const float* rotation, const float* position, void* user_data)
+{
+	pose_receiver* receiver = (pose_receiver*)user_data;
+
+	// samples arrive in order
+	TAssert(receiver->num_calls == 0 || time > receiver->last_time);
+
+	receiver->num_calls++;
+	receiver->last_time = time;
+	receiver->last_rotation = *(quatf*)rotation;
+
+	// no locks are held, so the device may be used from here
+	float ipd;
+	TAssert(ohmd_device_getf(device, OHMD_EYE_IPD, &ipd) == 0);
+}
+
+void test_pose_callback()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_device* dev = open_manual_device(ctx);
+
+	pose_receiver receiver = { 0 };
+	vec3f axis = {{0, 1, 0}}, ang_vel = {{0, 10, 0}};
+	quatf orient;
+
+	// samples from before the callback was set are not delivered
+	oquatf_init_axis(&orient, &axis, 0);
+	ohmd_device_push_sample(dev, 1.0, &orient, &ang_vel);
+
+	TAssert(ohmd_device_set_pose_callback(dev, receive_pose, &receiver) == 0);
+
+	for(int i = 1; i <= 10; i++){
+		oquatf_init_axis(&orient, &axis, i * 0.01f);
+		ohmd_device_push_sample(dev, 1.0 + i * 0.001, &orient, &ang_vel);
+	}
+
+	ohmd_ctx_update(ctx);
+
+	TAssert(receiver.num_calls == 10);
+	TAssert(float_eq((float)receiver.last_time, 1.01f, 0.0001f));
+	TAssert(quatf_eq(receiver.last_rotation, orient, 0.0001f));
+
+	// nothing new, nothing delivered
+	ohmd_ctx_update(ctx);
+	TAssert(receiver.num_calls == 10);
+
+	// samples that fell out of the history are skipped
+	for(int i = 11; i <= 10 + 2 * OHMD_POSE_HISTORY_SIZE; i++)
+		ohmd_device_push_sample(dev, 1.0 + i * 0.001, &orient, &ang_vel);
+
+	ohmd_ctx_update(ctx);
+	TAssert(receiver.num_calls == 10 + OHMD_POSE_HISTORY_SIZE - 1);
+
+	TAssert(ohmd_device_set_pose_callback(dev, NULL, NULL) == 0);
+
+	ohmd_device_push_sample(dev, 5.0, &orient, &ang_vel);
+	ohmd_ctx_update(ctx);
+	TAssert(receiver.num_calls == 10 + OHMD_POSE_HISTORY_SIZE - 1);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+static unsigned int sample_writer_thread(void* arg)
+{
+	ohmd_device* dev = (ohmd_device*)arg;
+	quatf orient = {{0, 0, 0, 1}};
+	vec3f ang_vel = {{0, 0, 0}};
+
+	for(int i = 0; i < 100; i++){
+		ohmd_sleep(0.001);
+		ohmd_device_push_sample(dev, ohmd_get_time(), &orient, &ang_vel);
+	}
+
+	return 0;
+}
+
+void test_pose_wait_for_sample()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_device* dev = open_manual_device(ctx);
+	unsigned int sample = 12345;
+
+	// nothing fused yet
+	TAssert(ohmd_device_wait_for_sample(dev, 0, 0.01, &sample) == OHMD_S_TIMEOUT);
+	TAssert(sample == 0);
+
+	ohmd_thread* thread = ohmd_create_thread(ctx, sample_writer_thread, dev);
+	TAssert(thread);
+
+	// every wait returns a newer sample, samples may be pushed faster than they are waited for
+	unsigned int last = 0;
+	while(last < 100){
+		TAssert(ohmd_device_wait_for_sample(dev, last, 1.0, &sample) == 0);
+		TAssert(sample > last);
+		last = sample;
+	}
+
+	ohmd_destroy_thread(thread);
+
+	// an older sample number returns right away
+	TAssert(ohmd_device_wait_for_sample(dev, 50, 0, &sample) == 0);
+	TAssert(sample == 100);
+
+	TAssert(ohmd_device_wait_for_sample(dev, 100, 0.01, &sample) == OHMD_S_TIMEOUT);
+
+	// a sample number the device hasn't reached yet isn't newer either, the whole timeout is waited out
+	double start = ohmd_get_tick();
+	TAssert(ohmd_device_wait_for_sample(dev, 150, 0.05, &sample) == OHMD_S_TIMEOUT);
+	TAssert(sample == 100);
+	TAssert(ohmd_get_tick() - start >= 0.045);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_pose_getf_multi()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_device* dev = open_manual_device(ctx);
+
+	float ipd = 0.07f;
+	TAssert(ohmd_device_setf(dev, OHMD_EYE_IPD, &ipd) == 0);
+
+	float rot[4], left[16], right[16], proj[16], got_ipd;
+	ohmd_float_value types[] = {
+		OHMD_ROTATION_QUAT, OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX, OHMD_RIGHT_EYE_GL_MODELVIEW_MATRIX,
+		OHMD_LEFT_EYE_GL_PROJECTION_MATRIX, OHMD_EYE_IPD
+	};
+	float* out[] = { rot, left, right, proj, &got_ipd };
+
+	TAssert(ohmd_device_getf_multi(dev, 5, types, out) == 0);
+
+	// the same values one at a time
+	float expected[16];
+	TAssert(ohmd_device_getf(dev, OHMD_ROTATION_QUAT, expected) == 0);
+	TAssert(memcmp(rot, expected, sizeof(float) * 4) == 0);
+	TAssert(ohmd_device_getf(dev, OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX, expected) == 0);
+	TAssert(memcmp(left, expected, sizeof(float) * 16) == 0);
+	TAssert(ohmd_device_getf(dev, OHMD_RIGHT_EYE_GL_MODELVIEW_MATRIX, expected) == 0);
+	TAssert(memcmp(right, expected, sizeof(float) * 16) == 0);
+	TAssert(ohmd_device_getf(dev, OHMD_LEFT_EYE_GL_PROJECTION_MATRIX, expected) == 0);
+	TAssert(memcmp(proj, expected, sizeof(float) * 16) == 0);
+	TAssert(got_ipd == ipd);
+
+	// a value the device can't give fails the call, the rest is still written
+	ohmd_float_value bad_types[] = { OHMD_EXTERNAL_SENSOR_FUSION, OHMD_EYE_IPD };
+	float bad[3];
+	float* bad_out[] = { bad, &got_ipd };
+
+	got_ipd = 0;
+	TAssert(ohmd_device_getf_multi(dev, 2, bad_types, bad_out) != 0);
+	TAssert(got_ipd == ipd);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_pose_get_frame()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_device* dev = open_manual_device(ctx);
+	ohmd_frame frame;
+
+	TAssert(ohmd_device_get_frame(dev, &frame) == 0);
+	TAssert(frame.sample == 0 && frame.time == 0);
+
+	vec3f axis = {{0, 1, 0}}, ang_vel = {{0, 0, 0}};
+	quatf orient;
+	oquatf_init_axis(&orient, &axis, 0.5f);
+	ohmd_device_push_sample(dev, 3.5, &orient, &ang_vel);
+	ohmd_ctx_update(ctx);
+
+	// a rotation correction applies to both eyes the same way
+	vec3f corr_axis = {{1, 0, 0}};
+	quatf corrected;
+	oquatf_init_axis(&corrected, &corr_axis, 0.3f);
+	TAssert(ohmd_device_setf(dev, OHMD_ROTATION_QUAT, (float*)&corrected) == 0);
+
+	float ipd = 0.064f;
+	TAssert(ohmd_device_setf(dev, OHMD_EYE_IPD, &ipd) == 0);
+
+	TAssert(ohmd_device_get_frame(dev, &frame) == 0);
+	TAssert(frame.sample == 1);
+	TAssert(frame.time == 3.5);
+	TAssert(frame.position[3] == 1.0f);
+
+	float expected[16];
+	TAssert(ohmd_device_getf(dev, OHMD_ROTATION_QUAT, expected) == 0);
+	TAssert(memcmp(frame.rotation, expected, sizeof(float) * 4) == 0);
+	TAssert(ohmd_device_getf(dev, OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX, expected) == 0);
+	TAssert(memcmp(frame.modelview_left, expected, sizeof(float) * 16) == 0);
+	TAssert(ohmd_device_getf(dev, OHMD_RIGHT_EYE_GL_PROJECTION_MATRIX, expected) == 0);
+	TAssert(memcmp(frame.projection_right, expected, sizeof(float) * 16) == 0);
+
+	// the eyes only differ by the ipd along x
+	for(int i = 0; i < 16; i++){
+		if(i == 12){
+			TAssert(float_eq(frame.modelview_left[i] - frame.modelview_right[i], ipd, 0.0001f));
+		}else{
+			TAssert(float_eq(frame.modelview_left[i], frame.modelview_right[i], 0.0001f));
+		}
+	}
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_pose_publish_on_change()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_device* dev = open_manual_device(ctx);
+
+	// nothing changed, nothing published
+	unsigned int seq = dev->pose_seq;
+	ohmd_ctx_update(ctx);
+	ohmd_ctx_update(ctx);
+	TAssert(dev->pose_seq == seq);
+
+	// a new sample
+	vec3f ang_vel = {{0, 0, 0}};
+	quatf orient = {{0, 0, 0, 1}};
+	ohmd_device_push_sample(dev, 1.0, &orient, &ang_vel);
+	ohmd_ctx_update(ctx);
+	TAssert(dev->pose_seq != seq);
+
+	// a property the modelview matrices depend on
+	seq = dev->pose_seq;
+	float ipd = 0.1f, modelview[16];
+	TAssert(ohmd_device_setf(dev, OHMD_EYE_IPD, &ipd) == 0);
+	TAssert(dev->pose_seq != seq);
+	TAssert(ohmd_device_getf(dev, OHMD_LEFT_EYE_GL_MODELVIEW_MATRIX, modelview) == 0);
+	TAssert(float_eq(modelview[12], ipd / 2.0f, 0.0001f));
+
+	seq = dev->pose_seq;
+	ohmd_ctx_update(ctx);
+	TAssert(dev->pose_seq == seq);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_pose_generation()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_device* dev = open_manual_device(ctx);
+
+	int sample, generation, last_generation;
+	double time;
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &sample) == 0);
+	TAssert(ohmd_device_geti(dev, OHMD_POSE_GENERATION, &last_generation) == 0);
+	TAssert(ohmd_device_get_sample_time(dev, &time) == 0);
+	TAssert(sample == 0);
+	TAssert(time == 0);
+
+	// nothing changed
+	ohmd_ctx_update(ctx);
+	TAssert(ohmd_device_geti(dev, OHMD_POSE_GENERATION, &generation) == 0);
+	TAssert(generation == last_generation);
+
+	// new samples
+	vec3f ang_vel = {{0, 0, 0}};
+	quatf orient = {{0, 0, 0, 1}};
+	ohmd_device_push_sample(dev, 1.0, &orient, &ang_vel);
+	ohmd_device_push_sample(dev, 1.5, &orient, &ang_vel);
+	ohmd_ctx_update(ctx);
+
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &sample) == 0);
+	TAssert(ohmd_device_geti(dev, OHMD_POSE_GENERATION, &generation) == 0);
+	TAssert(ohmd_device_get_sample_time(dev, &time) == 0);
+	TAssert(sample == 2);
+	TAssert(time == 1.5);
+	TAssert(generation > last_generation);
+	last_generation = generation;
+
+	// a correction changes the pose but not the sample
+	float rot[4] = { 0, 0.7071068f, 0, 0.7071068f };
+	TAssert(ohmd_device_setf(dev, OHMD_ROTATION_QUAT, rot) == 0);
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &sample) == 0);
+	TAssert(ohmd_device_geti(dev, OHMD_POSE_GENERATION, &generation) == 0);
+	TAssert(sample == 2);
+	TAssert(generation > last_generation);
+
+	ohmd_ctx_destroy(ctx);
+}
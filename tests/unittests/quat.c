@@ -152,3 +152,28 @@ void test_oquatf_diff()
 		TAssert(quatf_eq(q, list[i].q3, t));
 	}
 }
+
+typedef struct {
+	quatf q1, q2;
+	float f;
+	quatf q3;
+} quat2_float_quat;
+
+void test_oquatf_slerp()
+{
+	quat2_float_quat list[] = {
+		{ {{0, 0, 0, 1}}, {{0, 0.7071068, 0, 0.7071068}}, 0, {{0, 0, 0, 1}} },
+		{ {{0, 0, 0, 1}}, {{0, 0.7071068, 0, 0.7071068}}, 1, {{0, 0.7071068, 0, 0.7071068}} },
+		{ {{0, 0, 0, 1}}, {{0, 0.7071068, 0, 0.7071068}}, .5, {{0, 0.3826834, 0, 0.9238795}} },
+		// same rotation as above, with the sign flipped on the target
+		{ {{0, 0, 0, 1}}, {{0, -0.7071068, 0, -0.7071068}}, .5, {{0, 0.3826834, 0, 0.9238795}} },
+	};
+
+	int sz = sizeof(quat2_float_quat);
+
+	for(int i = 0; i < sizeof(list) / sz; i++){
+		quatf q;
+		oquatf_slerp(list[i].f, &list[i].q1, &list[i].q2, true, &q);
+		TAssert(quatf_eq(q, list[i].q3, t));
+	}
+}
@@ -0,0 +1,444 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Unit Tests - Oculus Rift Driver, Against the Mock HIDAPI */
+
+#include "tests.h"
+#include "mock_hidapi.h"
+#include "drv_oculus_rift/rift.h"
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_TEST_FILE "./rift-0-MOCK0000"
+#define CAPTURE_TEST_DIR "./rift-captures"
+
+static ohmd_context* create_rift_ctx(const ohmd_mock_hid_config* config)
+{
+	ohmd_mock_hid_set_config(config);
+
+	ohmd_ctx_settings* ctx_settings = ohmd_ctx_settings_create();
+	int drivers = OHMD_DRV_OCULUS_RIFT;
+	TAssert(ohmd_ctx_settings_seti(ctx_settings, OHMD_ICS_DRIVERS, &drivers) == 0);
+
+	ohmd_context* ctx = ohmd_ctx_create_ex(ctx_settings);
+	ohmd_ctx_settings_destroy(ctx_settings);
+	TAssert(ctx);
+	TAssert(ohmd_ctx_probe(ctx) == config->num_devices);
+
+	return ctx;
+}
+
+static ohmd_device* open_manual_update(ohmd_context* ctx, int index)
+{
+	// updates are up to the test
+	ohmd_device_settings* settings = ohmd_device_settings_create(ctx);
+	int auto_update = 0;
+	ohmd_device_settings_seti(settings, OHMD_IDS_AUTOMATIC_UPDATE, &auto_update);
+
+	ohmd_device* dev = ohmd_list_open_device_s(ctx, index, settings);
+	TAssert(dev);
+
+	ohmd_device_settings_destroy(settings);
+	return dev;
+}
+
+static void update_for(ohmd_context* ctx, double seconds)
+{
+	double end = ohmd_get_tick() + seconds;
+	while(ohmd_get_tick() < end){
+		ohmd_ctx_update(ctx);
+		ohmd_sleep(0.005);
+	}
+}
+
+// updates until the devices sent all of their config->max_reports reports and every one that
+// arrived was fused, one sample per report, returns false if that doesn't happen within seconds
+static bool update_until_fused(ohmd_context* ctx, const ohmd_mock_hid_config* config, ohmd_device** devs, int num_devs,
+	double seconds, ohmd_mock_hid_stats* stats)
+{
+	double end = ohmd_get_tick() + seconds;
+
+	do {
+		ohmd_ctx_update(ctx);
+		ohmd_mock_hid_get_stats(stats);
+
+		unsigned int sent = stats->input_reports + stats->dropped_reports + stats->overflowed_reports;
+		unsigned int fused = 0;
+
+		for(int i = 0; i < num_devs; i++){
+			int samples;
+			TAssert(ohmd_device_geti(devs[i], OHMD_SAMPLE_NUMBER, &samples) == 0);
+			fused += samples;
+		}
+
+		if(sent == config->max_reports * config->num_devices && fused == stats->input_reports)
+			return true;
+
+		ohmd_sleep(0.005);
+	} while(ohmd_get_tick() < end);
+
+	return false;
+}
+
+static float get_y_rotation(ohmd_device* dev)
+{
+	quatf rot;
+	TAssert(ohmd_device_getf(dev, OHMD_ROTATION_QUAT, rot.arr) == 0);
+	TAssert(fabsf(rot.x) < 0.01f && fabsf(rot.z) < 0.01f);
+
+	return 2.0f * acosf(rot.w);
+}
+
+void test_rift_packet_round_trip()
+{
+	pkt_tracker_sensor msg = { 0 }, decoded;
+	unsigned char buffer[64];
+
+	msg.num_samples = 5;
+	msg.timestamp = 0xfffe;
+	msg.last_command_id = 0x1234;
+	msg.temperature = -150;
+
+	// the extremes of the 21 bit range, of both signs
+	for(int i = 0; i < 3; i++){
+		for(int j = 0; j < 3; j++){
+			msg.samples[i].accel[j] = (i + j) % 2 ? -(1 << 20) : (1 << 20) - 1;
+			msg.samples[i].gyro[j] = (i * 3 + j) * 1234 - 5000;
+		}
+		msg.mag[i] = (int16_t)(-1000 * (i + 1));
+	}
+
+	int size = encode_tracker_sensor_msg(buffer, &msg);
+	TAssert(size == 62);
+	TAssert(buffer[0] == RIFT_IRQ_SENSORS);
+	TAssert(decode_tracker_sensor_msg(&decoded, buffer, size));
+
+	TAssert(decoded.num_samples == 5);
+	TAssert(decoded.timestamp == 0xfffe);
+	TAssert(decoded.last_command_id == 0x1234);
+	TAssert(decoded.temperature == -150);
+	TAssert(memcmp(decoded.samples, msg.samples, sizeof(msg.samples)) == 0);
+	TAssert(memcmp(decoded.mag, msg.mag, sizeof(msg.mag)) == 0);
+
+	// values are in 0.0001 units
+	vec3f v = {{ -1.5f, 0.25f, 9.81f }}, back;
+	int32_t smp[3];
+	rift_vec_from_vec3f(&v, smp);
+	vec3f_from_rift_vec(smp, &back);
+	TAssert(float_eq(back.x, v.x, 0.0002f) && float_eq(back.y, v.y, 0.0002f) && float_eq(back.z, v.z, 0.0002f));
+}
+
+void test_rift_open_close()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.angular_velocity.y = 0.5f;
+	config.max_reports = 250;
+
+	ohmd_context* ctx = create_rift_ctx(&config);
+	TAssert(strcmp(ohmd_list_gets(ctx, 0, OHMD_PRODUCT), "Rift (Devkit)") == 0);
+
+	double open_time = ohmd_get_tick();
+	ohmd_device* dev = open_manual_update(ctx, 0);
+
+	// the DK1 display info
+	int value;
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_HORIZONTAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1280);
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_VERTICAL_RESOLUTION, &value) == 0);
+	TAssert(value == 800);
+
+	// a sample per report at 1 kHz, every report sent arrived and was fused
+	ohmd_mock_hid_stats stats;
+	TAssert(update_until_fused(ctx, &config, &dev, 1, 5.0, &stats));
+	TAssert(stats.input_reports == config.max_reports);
+	TAssert(stats.keep_alives >= 1);
+
+	int samples;
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &samples) == 0);
+	TAssert(samples == (int)config.max_reports);
+	TAssert(ohmd_device_geti(dev, OHMD_SENSOR_QUEUE_OVERRUNS, &value) == 0);
+	TAssert(value == 0);
+
+	TAssert(float_eq(get_y_rotation(dev), samples * 0.001f * 0.5f, 0.01f));
+
+	// samples are stamped with host times
+	double time;
+	TAssert(ohmd_device_get_sample_time(dev, &time) == 0);
+	TAssert(time > open_time && time <= ohmd_get_tick());
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_rift_dropped_reports()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.angular_velocity.y = 0.5f;
+	config.drop_rate = 0.1;
+	config.jitter = 0.003;
+
+	ohmd_context* ctx = create_rift_ctx(&config);
+	ohmd_device* dev = open_manual_update(ctx, 0);
+
+	update_for(ctx, 0.3);
+
+	ohmd_mock_hid_stats stats;
+	ohmd_mock_hid_get_stats(&stats);
+	TAssert(stats.dropped_reports > 0);
+	TAssert(stats.input_reports > 150);
+
+	// late and missing reports don't stall or overrun the driver
+	int samples, dropped, value;
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &samples) == 0);
+	TAssert(samples > 150);
+	TAssert(ohmd_device_geti(dev, OHMD_SENSOR_QUEUE_OVERRUNS, &value) == 0);
+	TAssert(value == 0);
+
+	// the gaps are found from the device timestamps, all but the reports dropped
+	// after the last one that arrived
+	TAssert(ohmd_device_geti(dev, OHMD_DROPPED_SAMPLES, &dropped) == 0);
+	TAssert(dropped > 0 && dropped <= (int)stats.dropped_reports && dropped > (int)stats.dropped_reports - 10);
+
+	// and fused over, so the rotation covers the missing samples too
+	TAssert(float_eq(get_y_rotation(dev), (samples + dropped) * 0.001f * 0.5f, 0.005f));
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_rift_slow_reports()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.angular_velocity.y = 0.5f;
+	config.report_rate = 200.0;
+
+	ohmd_context* ctx = create_rift_ctx(&config);
+	ohmd_device* dev = open_manual_update(ctx, 0);
+
+	update_for(ctx, 0.3);
+
+	// five samples per report, only three of which fit
+	int samples, late;
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &samples) == 0);
+	TAssert(ohmd_device_geti(dev, OHMD_LATE_SAMPLES, &late) == 0);
+	TAssert(samples > 0 && samples % 3 == 0);
+	TAssert(late == samples / 3 * 2);
+
+	TAssert(float_eq(get_y_rotation(dev), (samples + late) * 0.001f * 0.5f, 0.005f));
+
+	int dropped;
+	TAssert(ohmd_device_geti(dev, OHMD_DROPPED_SAMPLES, &dropped) == 0);
+	TAssert(dropped == 0);
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_rift_timestamp_wraparound()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.angular_velocity.y = 0.5f;
+	config.first_timestamp = 0xffff - 100;
+
+	ohmd_context* ctx = create_rift_ctx(&config);
+	ohmd_device* dev = open_manual_update(ctx, 0);
+
+	update_for(ctx, 0.3);
+
+	// the timestamps wrap around 0.1 s in, which is neither a gap nor a step back
+	int samples, dropped;
+	TAssert(ohmd_device_geti(dev, OHMD_SAMPLE_NUMBER, &samples) == 0);
+	TAssert(samples > 200);
+	TAssert(ohmd_device_geti(dev, OHMD_DROPPED_SAMPLES, &dropped) == 0);
+	TAssert(dropped == 0);
+
+	TAssert(float_eq(get_y_rotation(dev), samples * 0.001f * 0.5f, 0.005f));
+
+	ohmd_ctx_destroy(ctx);
+}
+
+void test_rift_feature_latency()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.feature_latency = 0.02;
+
+	set_env("OPENHMD_CACHE_DIR", ".");
+	remove(CACHE_TEST_FILE);
+
+	ohmd_context* ctx = create_rift_ctx(&config);
+	ohmd_mock_hid_stats stats;
+
+	// the first open reads the device, several round trips
+	ohmd_device* dev = open_manual_update(ctx, 0);
+	ohmd_mock_hid_get_stats(&stats);
+	unsigned int first_open_reports = stats.opener_feature_reports;
+	TAssert(first_open_reports >= 3);
+	ohmd_close_device(dev);
+
+	// the second one is opened from the cache, and reads the device in the background
+	dev = open_manual_update(ctx, 0);
+	ohmd_mock_hid_get_stats(&stats);
+	TAssert(stats.opener_feature_reports == first_open_reports);
+
+	int value;
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_HORIZONTAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1280);
+
+	update_for(ctx, 0.2);
+	ohmd_ctx_destroy(ctx);
+
+	set_env("OPENHMD_CACHE_DIR", "");
+	remove(CACHE_TEST_FILE);
+}
+
+void test_rift_stale_cache()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.h_resolution = 1920;
+	config.v_resolution = 1080;
+
+	set_env("OPENHMD_CACHE_DIR", ".");
+	remove(CACHE_TEST_FILE);
+
+	// cache a different screen than the device has now
+	ohmd_context* ctx = create_rift_ctx(&config);
+	ohmd_close_device(open_manual_update(ctx, 0));
+	ohmd_ctx_destroy(ctx);
+
+	// slow enough for the keep alive to be due while the device is being verified
+	ohmd_mock_hid_get_default_config(&config);
+	config.feature_latency = 0.15;
+
+	ctx = create_rift_ctx(&config);
+	ohmd_device* dev = open_manual_update(ctx, 0);
+
+	int value;
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_HORIZONTAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1920);
+
+	update_for(ctx, 1.3);
+
+	// the config read in the background replaced the cached one
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_HORIZONTAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1280);
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_VERTICAL_RESOLUTION, &value) == 0);
+	TAssert(value == 800);
+
+	// and the keep alive didn't cut into its feature reports
+	ohmd_mock_hid_stats stats;
+	ohmd_mock_hid_get_stats(&stats);
+	TAssert(stats.keep_alives >= 2);
+	TAssert(stats.overlapping_feature_reports == 0);
+
+	ohmd_close_device(dev);
+
+	// and was written to the cache
+	dev = open_manual_update(ctx, 0);
+	TAssert(ohmd_device_geti(dev, OHMD_SCREEN_HORIZONTAL_RESOLUTION, &value) == 0);
+	TAssert(value == 1280);
+
+	ohmd_ctx_destroy(ctx);
+
+	set_env("OPENHMD_CACHE_DIR", "");
+	remove(CACHE_TEST_FILE);
+}
+
+// counts the captures in CAPTURE_TEST_DIR with at least a header and a record, and removes them all
+static int remove_captures()
+{
+	DIR* dir = opendir(CAPTURE_TEST_DIR);
+	if(!dir)
+		return 0;
+
+	int count = 0;
+	struct dirent* entry;
+
+	while((entry = readdir(dir)) != NULL){
+		if(entry->d_name[0] == '.')
+			continue;
+
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", CAPTURE_TEST_DIR, entry->d_name);
+
+		struct stat st;
+		if(stat(path, &st) == 0 && st.st_size > 8 + 12)
+			count++;
+
+		remove(path);
+	}
+
+	closedir(dir);
+	return count;
+}
+
+void test_rift_capture_names()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+
+	mkdir(CAPTURE_TEST_DIR, 0755);
+	remove_captures();
+	set_env("OPENHMD_CAPTURE_DIR", CAPTURE_TEST_DIR);
+
+	ohmd_context* ctx = create_rift_ctx(&config);
+
+	// all within the same second, none of them overwrites another
+	for(int i = 0; i < 3; i++){
+		ohmd_device* dev = open_manual_update(ctx, 0);
+		update_for(ctx, 0.05);
+		ohmd_close_device(dev);
+	}
+
+	ohmd_ctx_destroy(ctx);
+	set_env("OPENHMD_CAPTURE_DIR", "");
+
+	TAssert(remove_captures() == 3);
+	rmdir(CAPTURE_TEST_DIR);
+}
+
+void test_rift_many_devices()
+{
+	ohmd_mock_hid_config config;
+	ohmd_mock_hid_get_default_config(&config);
+	config.num_devices = 4;
+	config.feature_latency = 0.01;
+	config.max_reports = 250;
+
+	ohmd_context* ctx = create_rift_ctx(&config);
+
+	// the devices are read at the same time rather than one after another
+	int indices[4] = { 0, 1, 2, 3 };
+	ohmd_device* devs[4];
+
+	TAssert(ohmd_list_open_devices(ctx, 4, indices, NULL, devs) == 4);
+
+	ohmd_mock_hid_stats stats;
+	ohmd_mock_hid_get_stats(&stats);
+	TAssert(stats.max_concurrent_feature_reports > 1);
+	TAssert(stats.overlapping_feature_reports == 0);
+
+	// at 1 kHz each, fused by the context's thread. The devices sample from when they're opened,
+	// the reports sent while they were being read overflow the host buffer, every later one is fused.
+	TAssert(update_until_fused(ctx, &config, devs, 4, 5.0, &stats));
+	TAssert(stats.dropped_reports == 0);
+	TAssert(stats.input_reports > 0 && stats.input_reports + stats.overflowed_reports == config.max_reports * 4);
+
+	for(int i = 0; i < 4; i++){
+		int value;
+		TAssert(ohmd_device_geti(devs[i], OHMD_SAMPLE_NUMBER, &value) == 0);
+		TAssert(value > 0);
+		TAssert(ohmd_device_geti(devs[i], OHMD_SENSOR_QUEUE_OVERRUNS, &value) == 0);
+		TAssert(value == 0);
+	}
+
+	ohmd_ctx_destroy(ctx);
+}
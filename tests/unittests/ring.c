@@ -0,0 +1,110 @@
+/*
+ * OpenHMD - Free and Open Source API and drivers for immersive technology.
+ * Copyright (C) 2013 Fredrik Hultin.
+ * Copyright (C) 2013 Jakob Bornecrantz.
+ * Distributed under the Boost 1.0 licence, see LICENSE for full text.
+ */
+
+/* Unit Tests - Report Ring */
+
+#include "tests.h"
+
+#define RING_SIZE 64
+#define NUM_THREADED_ITEMS 200000
+
+void test_ring_depth_overruns()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	TAssert(ohmd_create_ring(ctx, sizeof(int), 48) == NULL);
+
+	ohmd_ring* ring = ohmd_create_ring(ctx, sizeof(int), RING_SIZE);
+	TAssert(ring);
+	TAssert(ohmd_ring_peek(ring) == NULL);
+	TAssert(!ohmd_ring_wait(ring, 0.01));
+
+	// fill it up, the items past the end are dropped
+	for(int i = 0; i < RING_SIZE + 10; i++){
+		int* item = ohmd_ring_begin_push(ring);
+		TAssert((item != NULL) == (i < RING_SIZE));
+		if(item){
+			*item = i;
+			ohmd_ring_end_push(ring);
+		}
+	}
+
+	TAssert(ohmd_ring_get_depth(ring) == RING_SIZE);
+	TAssert(ohmd_ring_get_overruns(ring) == 10);
+	TAssert(ohmd_ring_wait(ring, 0));
+
+	// a slot given up without ohmd_ring_end_push isn't queued
+	ohmd_ring_pop(ring);
+	TAssert(ohmd_ring_begin_push(ring) != NULL);
+	TAssert(ohmd_ring_get_depth(ring) == RING_SIZE - 1);
+
+	// in order, wrapping around
+	for(int i = 1; i < RING_SIZE; i++){
+		int* item = ohmd_ring_begin_push(ring);
+		TAssert(item);
+		*item = RING_SIZE + i;
+		ohmd_ring_end_push(ring);
+
+		item = ohmd_ring_peek(ring);
+		TAssert(item && *item == i);
+		ohmd_ring_pop(ring);
+	}
+
+	TAssert(ohmd_ring_get_depth(ring) == RING_SIZE - 1);
+	TAssert(ohmd_ring_get_overruns(ring) == 10);
+
+	ohmd_destroy_ring(ring);
+	ohmd_ctx_destroy(ctx);
+}
+
+static unsigned int push_items(void* arg)
+{
+	ohmd_ring* ring = (ohmd_ring*)arg;
+
+	for(int i = 0; i < NUM_THREADED_ITEMS; i++){
+		int* item = ohmd_ring_begin_push(ring);
+		if(item){
+			item[0] = i;
+			item[1] = -i;
+			ohmd_ring_end_push(ring);
+		}
+	}
+
+	return 0;
+}
+
+void test_ring_threaded()
+{
+	ohmd_context* ctx = ohmd_ctx_create();
+	TAssert(ctx);
+
+	ohmd_ring* ring = ohmd_create_ring(ctx, 2 * sizeof(int), RING_SIZE);
+	TAssert(ring);
+
+	ohmd_thread* thread = ohmd_create_thread(ctx, push_items, ring);
+	TAssert(thread);
+
+	// every item arrives whole and in order, or is counted as an overrun
+	int count = 0, last = -1;
+	while(last < NUM_THREADED_ITEMS - 1 && ohmd_ring_wait(ring, 1.0)){
+		int* item = ohmd_ring_peek(ring);
+		TAssert(item);
+		TAssert(item[0] > last && item[1] == -item[0]);
+		last = item[0];
+		count++;
+		ohmd_ring_pop(ring);
+	}
+
+	ohmd_destroy_thread(thread);
+
+	TAssert(ohmd_ring_get_depth(ring) == 0);
+	TAssert(count + (int)ohmd_ring_get_overruns(ring) == NUM_THREADED_ITEMS);
+
+	ohmd_destroy_ring(ring);
+	ohmd_ctx_destroy(ctx);
+}
@@ -20,6 +20,8 @@
 
 bool float_eq(float a, float b, float t);
 bool vec3f_eq(vec3f v1, vec3f v2, float t);
+bool quatf_eq(quatf q1, quatf q2, float t);
+void set_env(const char* name, const char* value);
 
 // vec3f tests
 void test_ovec3f_normalize_me();
@@ -37,11 +39,56 @@ void test_oquatf_get_length();
 void test_oquatf_get_dot();
 void test_oquatf_inverse();
 void test_oquatf_diff();
+void test_oquatf_slerp();
 
 void test_oquatf_get_mat4x4();
 
 // high-level tests
 void test_highlevel_open_close_device();
 void test_highlevel_open_close_many_devices();
+void test_highlevel_slow_update_isolated();
+void test_highlevel_close_waiting_device();
+void test_highlevel_close_from_callback();
+void test_highlevel_dedicated_update_thread();
+void test_highlevel_open_close_hundreds_of_devices();
+void test_highlevel_device_list_growth();
+void test_highlevel_probe_async();
+void test_highlevel_ctx_create_ex();
+void test_highlevel_open_devices();
+void test_highlevel_supported_values();
+
+// pose tests
+void test_pose_concurrent_reads();
+void test_pose_history_interpolation();
+void test_pose_callback();
+void test_pose_wait_for_sample();
+void test_pose_getf_multi();
+void test_pose_get_frame();
+void test_pose_publish_on_change();
+void test_pose_generation();
+
+// hotplug tests
+void test_hotplug_add_remove();
+
+// ring tests
+void test_ring_depth_overruns();
+void test_ring_threaded();
+
+// capture tests
+void test_capture_write_read();
+void test_capture_create_new();
+void test_capture_replay();
+void test_capture_replay_interleaved();
+
+// rift tests, against the mock hidapi
+void test_rift_packet_round_trip();
+void test_rift_open_close();
+void test_rift_dropped_reports();
+void test_rift_slow_reports();
+void test_rift_timestamp_wraparound();
+void test_rift_feature_latency();
+void test_rift_stale_cache();
+void test_rift_capture_names();
+void test_rift_many_devices();
 
 #endif